@@ -0,0 +1,109 @@
+#ifndef CS3P98_BLOCK_ARENA_H
+#define CS3P98_BLOCK_ARENA_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+	Block Arena
+	Fixed pool of equally sized float blocks carved out of a single up front allocation. Blocks are handed out and
+	returned without touching the heap, so recycling them (ie. for terrain chunk data) is allocation free.
+
+	When every block is in use, acquire blocks until another thread releases one - this provides back pressure between
+	a producer filling blocks and a consumer draining them. Closing the arena releases all blocked threads.
+*/
+class BlockArena {
+private:
+
+	// instance data
+	const size_t blockSize;							// # floats per block
+	const size_t blockCount;						// # blocks in arena
+	std::unique_ptr<float[]> storage;				// backing storage for every block
+	std::vector<float*> free;						// blocks not currently in use - never grows past blockCount
+	mutable std::mutex lock;
+	std::condition_variable released;				// signalled on release and close
+	bool closed;
+	std::atomic<size_t> acquired;					// total # blocks handed out over the arena's lifetime
+
+	static std::atomic<size_t> heapAllocations;		// # heap allocations made by all arenas
+
+public:
+
+	// Constructor - allocates storage for every block at once
+	BlockArena(size_t floatsPerBlock, size_t blocks) :
+		blockSize(floatsPerBlock), blockCount(blocks), storage(new float[floatsPerBlock * blocks]()), closed(false), acquired(0)
+	{
+		heapAllocations++;
+		free.reserve(blocks);
+		for (size_t i = blocks; i > 0; i--) free.push_back(storage.get() + (i - 1) * blockSize);	// hand out blocks in address order
+	}
+
+	// delete copy and move
+	BlockArena(const BlockArena& other) = delete;
+	BlockArena& operator=(const BlockArena& other) = delete;
+
+	// take a block, waiting for one to be released if none are free. returns nullptr once the arena has been closed
+	float* acquire() {
+		std::unique_lock<std::mutex> lk(lock);
+		released.wait(lk, [this] { return closed || !free.empty(); });
+		if (closed) return nullptr;
+		float* block = free.back();
+		free.pop_back();
+		acquired++;
+		return block;
+	}
+
+	// take a block if one is free. never blocks
+	float* tryAcquire() {
+		std::lock_guard<std::mutex> lk(lock);
+		if (free.empty()) return nullptr;
+		float* block = free.back();
+		free.pop_back();
+		acquired++;
+		return block;
+	}
+
+	// return a block obtained from acquire to the arena
+	void release(float* block) {
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			free.push_back(block);
+		}
+		released.notify_one();
+	}
+
+	// release every blocked thread - subsequent acquire calls return nullptr immediately
+	void close() {
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			closed = true;
+		}
+		released.notify_all();
+	}
+
+	// # floats per block
+	size_t size() const { return blockSize; }
+
+	// # blocks in arena
+	size_t capacity() const { return blockCount; }
+
+	// # blocks currently free
+	size_t available() const {
+		std::lock_guard<std::mutex> lk(lock);
+		return free.size();
+	}
+
+	// total # blocks handed out by this arena
+	size_t acquisitions() const { return acquired; }
+
+	// total # heap allocations made by all arenas - constant once every arena has been constructed
+	static size_t allocations() { return heapAllocations; }
+};
+
+// Initialize static values
+std::atomic<size_t> BlockArena::heapAllocations(0);
+
+#endif
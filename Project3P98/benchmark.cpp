@@ -0,0 +1,143 @@
+/*
+	Terrain Generation Benchmark - Measures chunk generation speed without a window or GL context
+
+	Reports the index count and vertex shader invocations of a chunk at every level of detail, the cost of each generation
+	stage in ns per vertex, whole chunk throughput across thread counts, and the number of heap allocations made while
+	generating. Only generation is timed - GPU upload (Chunk::glLoad) is not.
+
+	Build with the terrain_benchmark CMake target, or by hand (from this directory):
+		g++ -std=c++14 -O2 -mavx2 -pthread -I"../GL Dependencies/include" benchmark.cpp "../GL Dependencies/glad.c" -ldl -o benchmark
+	Usage:
+		./benchmark [chunks per run = 64]
+*/
+
+#define COUNT_HEAP_ALLOCATIONS		// count allocations made while generating - this is the only translation unit of the benchmark
+#include "heapcounter.h"
+#include "arena.h"
+#include "chunk.h"
+#include "threadpool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// seconds elapsed since start
+static double since(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// run body repeatedly for at least minSeconds, returns the mean seconds per call
+template <typename F>
+static double measure(F&& body, double minSeconds = 0.5) {
+	body();											// warm up
+	int calls = 0;
+	Clock::time_point start = Clock::now();
+	do {
+		body();
+		calls++;
+	} while (since(start) < minSeconds);
+	return since(start) / calls;
+}
+
+int main(int argc, char** argv) {
+	const int chunks = argc > 1 ? std::max(1, atoi(argv[1])) : 64;
+	const int vdim = (int)sqrt((double)Chunk::numVertices());
+	const int vertices = Chunk::numVertices();
+	const double nsPerVertex = 1e9 / vertices;
+	volatile float sink = 0.0f;						// keeps timed results alive
+
+	printf("Chunk: %d x %d vertices, %d floats of mesh data per chunk\n", vdim, vdim, Chunk::meshElements());
+
+	// index topology - vertex shader work per chunk at every level of detail
+	printf("\nIndex topology: %s, u%d indices, %d entry FIFO post-transform vertex cache\n", Chunk::triangleStrips() ? "triangle strips" : "triangle lists",
+		8 * Chunk::indexSize(), Chunk::vertexCacheSize());
+	printf("  %3s  %8s  %11s  %12s\n", "lod", "indices", "VS invocs", "invocs/vert");
+	for (int lod = 0; lod < Chunk::lodLevels(); lod++) {
+		int invocations = Chunk::vertexShaderInvocations(lod);
+		printf("  %3d  %8d  %11d  %12.2f\n", lod, Chunk::indexCount(lod), invocations, (double)invocations / vertices);
+	}
+
+	// per stage cost on a single thread - one chunk's worth of rows at a time
+	std::vector<float> heights(vdim), dhdx(vdim), dhdz(vdim);
+	double noise = measure([&] {
+		for (int z = 0; z < vdim; z++) Chunk::computeHeightRow(0.0f, 4.0f * z, 4.0f, heights.data(), vdim);
+		sink = sink + heights[0];
+	});
+	double noiseGradient = measure([&] {
+		for (int z = 0; z < vdim; z++) Chunk::computeHeightRow(0.0f, 4.0f * z, 4.0f, heights.data(), dhdx.data(), dhdz.data(), vdim);
+		sink = sink + dhdx[0];
+	});
+#ifndef FINITE_DIFFERENCE_NORMALS
+	// normals from the gradients of every row of a chunk, generated up front so only the normal pass is timed
+	std::vector<float> fieldx(vdim * vdim), fieldz(vdim * vdim), normalData(3 * vdim);
+	for (int z = 0; z < vdim; z++) Chunk::computeHeightRow(0.0f, 4.0f * z, 4.0f, heights.data(), &fieldx[z * vdim], &fieldz[z * vdim], vdim);
+	double normals = measure([&] {
+		for (int z = 0; z < vdim; z++) {
+			const float* rowx = &fieldx[z * vdim];
+			const float* rowz = &fieldz[z * vdim];
+			for (int x = 0; x < vdim; x++) {					// as generateMeshData stores them
+				glm::vec3 n = Chunk::gradientNormal(rowx[x], rowz[x]);
+				normalData[3 * x] = n.x;
+				normalData[3 * x + 1] = n.y;
+				normalData[3 * x + 2] = n.z;
+			}
+		}
+		sink = sink + normalData[0];
+	});
+#endif
+	ThreadPool serial(0);
+	BlockArena heightArena(Chunk::heightElements(), 1), meshArena(Chunk::meshElements(), 1);
+	Chunk chunk;
+	chunk.attach(heightArena.acquire());
+	float* mesh = meshArena.acquire();
+	int next = 0;
+	double total = measure([&] {
+		chunk.generate(next % 16, next / 16 % 16, mesh, serial);
+		next++;
+	});
+	printf("\nStage cost, 1 thread (ns/vertex)\n");
+	printf("  noise (height only)      %8.1f\n", noise * nsPerVertex);
+	printf("  noise (height+gradient)  %8.1f\n", noiseGradient * nsPerVertex);
+#ifndef FINITE_DIFFERENCE_NORMALS
+	printf("  normals (from gradient)  %8.1f\n", normals * nsPerVertex);
+#endif
+	printf("  generate total           %8.1f  (%.3f ms/chunk)\n", total * nsPerVertex, total * 1e3);
+
+	// whole chunk throughput - chunks are spread across the pool and each splits its rows into bands on the same pool
+	printf("\nThroughput (%d chunks per run)\n", chunks);
+	printf("  %7s  %10s  %8s  %14s\n", "threads", "chunks/s", "speedup", "allocs/chunk");
+	unsigned int hw = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> counts = { 1 };
+	for (unsigned int t = 2; t < hw; t *= 2) counts.push_back(t);
+	if (hw > 1) counts.push_back(hw);
+	double base = 0.0;
+	for (unsigned int threads : counts) {
+		ThreadPool pool(threads - 1);				// the calling thread works too
+		BlockArena heightBlocks(Chunk::heightElements(), chunks), meshBlocks(Chunk::meshElements(), chunks);
+		std::vector<Chunk> batch(chunks);
+		std::vector<float*> meshes(chunks);
+		for (int i = 0; i < chunks; i++) {
+			batch[i].attach(heightBlocks.acquire());
+			meshes[i] = meshBlocks.acquire();
+		}
+		int run = 0;
+		size_t allocsBefore = 0, allocsAfter = 0;
+		double seconds = measure([&] {
+			allocsBefore = HeapCounter::total();
+			pool.parallelFor(0, chunks, [&](int first, int last) {
+				for (int i = first; i < last; i++) batch[i].generate(run * chunks + i, run, meshes[i], pool);
+			});
+			allocsAfter = HeapCounter::total();
+			run++;
+		}, 1.0);
+		double rate = chunks / seconds;
+		if (threads == 1) base = rate;
+		printf("  %7u  %10.1f  %7.2fx  %14.2f\n", threads, rate, rate / base, (double)(allocsAfter - allocsBefore) / chunks);
+	}
+
+	printf("\nArena heap allocations: %zu (total process allocations: %zu)\n", BlockArena::allocations(), HeapCounter::total());
+	return sink == 12345.0f ? 1 : 0;
+}
@@ -1,13 +1,19 @@
 #ifndef CS3P98_CHUNK_CACHE_H
 #define CS3P98_CHUNK_CACHE_H
 
+#include "arena.h"
 #include "chunk.h"
-#include <GLFW/glfw3.h>
+#include "concurrentqueue.h"
+#include "frustum.h"
+#include "heapcounter.h"
+#include "terrainbuffers.h"
+#include "threadpool.h"
+#include "tilecache.h"
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <iostream>
-#include <queue>
 #include <thread>
-#include <chrono>
 
 /*
 	Chunk Cache Structure
@@ -24,12 +30,31 @@
 	
 	When a chunk is requested to be drawn via the cache, the cache first checks to see if that chunk is cached.
 	If so, the cached chunk is accessed and drawn. If not, the cache domain lines are shifted approriately and
-	the corresponding row or column of old chunk data is reloaded with updated chunks.
+	the corresponding rows or columns of old chunk data are reloaded with updated chunks. The domain may move any
+	distance in a single call (ie. after a teleport) - chunks still inside the shifted domain remain valid.
+
+	Draw calls accept a chunk coordinate along with the level of detail to draw that chunk at. This allows the world class
+	to determine the level of detail required for each chunk (see Chunk::lodLevels).
+
+	Pending load requests are scheduled by priority rather than FIFO order - chunks close to the focus (active) chunk and
+	in front of the camera are generated first. Requests whose cache slot has since been recycled by another domain shift
+	are cancelled rather than generated.
+
+	Chunk data is recycled in place - every cache slot owns a fixed height field carved out of one arena, and generated
+	meshes are staged in a small fixed pool of blocks that are returned once uploaded. Steady state chunk loading
+	performs no heap allocations - build with COUNT_HEAP_ALLOCATIONS to measure it (see allocations).
+
+	Generated chunks are also written to disk (see TileCache) - chunks that are revisited, in this run or a later one, are
+	read back from their memory mapped tile instead of being generated again.
+
+	Chunks whose bounding box lies outside of the view frustum are not drawn, and their pending loads are deferred behind
+	those of visible chunks.
+
+	GPU storage is lent to the cache (see TerrainBuffers). A cache constructed without it still loads chunks and answers
+	height queries, but uploads and draws nothing - it needs no GL context.
 
-	TODO: change draw call to accept chunk coordinate along with corresponding level of detail for that chunk. This allows
-		the level class to determine the level of detail required for each chunk
-	TODO: change Chunk Load Request Queue to priority queue -> allow active chunk to be drawn with highest priority
-		(priority can coincide with level of detail for chunk)
+	Height queries (getHeight) may be made from any thread while chunks are loading - slots that are not valid, or that are
+	recycled mid query, fall back to a cheap estimate of the terrain height (see Chunk::estimateHeight).
 */
 class Cache {
 private:
@@ -39,107 +64,270 @@ private:
 
 	// Cached chunk wrapper
 	struct CachedChunk {
-		CACHESTATUS status = CACHESTATUS::INVALID;
-		Chunk chunk;
-		CachedChunk() : chunk(true) {}					// initialize as dummy chunk without computed mesh data
+		std::atomic<CACHESTATUS> status;
+		std::atomic<unsigned int> ticket;				// incremented whenever the slot is invalidated - outstanding load requests for older tickets are stale
+		std::atomic<bool> visible;						// slot intersected the view frustum when last drawn
+		std::atomic<int> chunkx, chunkz;				// chunk coordinate the slot was last queued to load
+		Chunk chunk;									// generated in place - height storage is attached by the cache
+		CachedChunk() : status(CACHESTATUS::INVALID), ticket(0), visible(true), chunkx(0), chunkz(0) {}
 	};
 
 	// Load request queue wrapper
 	struct ChunkLoadRequest {
 		CachedChunk* chunk = nullptr;					// Cached chunk to load into
+		unsigned int ticket;							// slot ticket at request time
 		int chunkx;										// chunk coordinate to load
 		int chunkz;
+		inline bool stale() const {						// true if the slot was recycled after this request was made
+			return ticket != chunk->ticket.load();
+		}
 	};
 
 	// GL Init request wrapper
 	struct GLInitRequest {
 		CachedChunk* chunk = nullptr;					// cached chunk to glLoad
+		unsigned int ticket;							// slot ticket the chunk was generated for
+		float* mesh = nullptr;							// staging block holding the generated mesh - returned to the arena once consumed
+		TileCache::Tile tile;							// mapped tile the mesh is read from instead, if any - unmapped once consumed
+		const float* data() const {						// mesh data to upload
+			return tile.data ? tile.mesh() : mesh;
+		}
 	};
 
 	// class constants
 	static constexpr int DIM = 30;						// cache matrix dimension [recommended >= 10] - SHOULD BE LARGE ENOUGH TO FIT WORLD RENDER WIDTH
 	static constexpr int CACHE_VOLUME = DIM * DIM;		// cache volume - maximum total chunks cached at any time
 	static constexpr bool CACHE_PRELOAD = 0;			// preload all chunks in cache on initialization on main thread - !WARNING! COMPUTATIONALLY AND SPACE INTENSIVE
-	static constexpr int POLL_DELAY_MILLIS = 200;		// millisecond delay between load request polling while empty
-	const std::chrono::milliseconds POLL_DELAY;
+	static constexpr double UPLOAD_BUDGET_MILLIS = 4.0;	// default time per frame spent uploading generated chunks to the GPU
+	static constexpr float CULLED_LOAD_PENALTY = 4.0f;	// load priority multiplier for chunks outside of the view frustum
+	static constexpr int STAGING_BLOCKS = 32;			// # generated meshes that may await upload at once - loading stalls while all are in use
+	static constexpr bool TILE_CACHE = true;			// persist generated chunks to disk and read revisited chunks back instead of regenerating them
+	static constexpr int MISS_BATCH = 64;				// # height queries missing the cache that getHeights estimates together
 
 	// class helper functions
-	inline int index(int x, int y) {					// compute 1d index from 2d index
+	static inline int index(int x, int y) {					// compute 1d index from 2d index
 		return y * DIM + x;
 	}
 	inline int wrap(int a) {							// compute cache dimension wrapped index
 		return (a + DIM) % DIM;
 	}
+	static inline double now() {						// monotonic time in seconds
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	static inline int modulo(int a) {					// wrap any integer into [0, DIM)
+		return ((a % DIM) + DIM) % DIM;
+	}
+	inline int slot(const CachedChunk& cc) {			// compute cache matrix index of a cached chunk - doubles as its slot in the terrain buffers
+		return (int)(&cc - cache.data());
+	}
+	inline void glLoad(CachedChunk& cc, const float* mesh) {	// upload mesh data into its slot of the terrain buffers, if any - call from main thread
+		if (buffers) buffers->upload(cc.chunk, slot(cc), mesh);
+	}
+	inline void recycle(GLInitRequest& glr) {			// return the storage of a consumed init request
+		if (glr.tile.data) TileCache::close(glr.tile);
+		else meshArena.release(glr.mesh);
+	}
+	inline bool tryHeight(float wx, float wz, float& h) const {	// read the height at a world coordinate from the cached chunk containing it - safe to call from any thread
+		/*
+			Domain shifts move the reference chunk and the domain boundary together, so a chunk coordinate always maps to the
+			same slot (see slotx) and no domain state is read here. Each slot's ticket acts as a sequence lock: it is bumped
+			before the slot's height field can be regenerated, so a read that began on a valid slot and ends with the ticket
+			unchanged saw a height field that was not being written. Returns false if the slot is not valid or was recycled.
+		*/
+		int chunkx = Chunk::chunkCoord(wx), chunkz = Chunk::chunkCoord(wz);
+		const CachedChunk& cc = cache[index(modulo(chunkx + slotx), modulo(chunkz + slotz))];
+		unsigned int ticket = cc.ticket.load(std::memory_order_acquire);
+		if (cc.status.load(std::memory_order_acquire) != CACHESTATUS::VALID || cc.chunkx != chunkx || cc.chunkz != chunkz) return false;
+		h = cc.chunk.getHeight(wx, wz);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return cc.ticket.load(std::memory_order_relaxed) == ticket;
+	}
+	inline void invalidate(CachedChunk& cc) {			// invalidate a single slot - cancels any load request outstanding for it
+		cc.status = CACHESTATUS::INVALID;
+		cc.ticket++;
+	}
 	inline void invalidateColumn(int x) {				// invalidate cache column x - x must be valid array index (NOT CHUNK COORD)
-		for (int row = 0; row < DIM; row++) cache[index(x, row)].status = CACHESTATUS::INVALID;
+		for (int row = 0; row < DIM; row++) invalidate(cache[index(x, row)]);
 	}
 	inline void invalidateRow(int z) {					// invalidate cache row - z must be valid array index
-		for (int col = 0; col < DIM; col++) cache[index(col, z)].status = CACHESTATUS::INVALID;
+		for (int col = 0; col < DIM; col++) invalidate(cache[index(col, z)]);
+	}
+	void contain(int chunkx, int chunkz) {				// shift the domain the least distance needed to contain the given chunk coordinate
+		int distx = chunkx - refx;						// compute distance from reference point in chunk space
+		int distz = chunkz - refz;
+		int kx = distx < 0 ? distx : (distx >= DIM ? distx - DIM + 1 : 0);		// # columns / rows to shift by - negative shifts west / south
+		int kz = distz < 0 ? distz : (distz >= DIM ? distz - DIM + 1 : 0);
+		int stepsx = std::min(abs(kx), DIM);			// shifting by DIM or more invalidates the whole cache once
+		int stepsz = std::min(abs(kz), DIM);
+		for (int i = 0; i < stepsx; i++) {
+			if (kx < 0) {								// west cache miss
+				domx = wrap(domx - 1);					// shift horizontal domain boundary line
+				invalidateColumn(domx);					// invalidate old chunk data
+			}
+			else {										// east cache miss
+				invalidateColumn(domx);
+				domx = wrap(domx + 1);
+			}
+		}
+		for (int i = 0; i < stepsz; i++) {
+			if (kz < 0) {								// south cache miss
+				domz = wrap(domz - 1);
+				invalidateRow(domz);
+			}
+			else {										// north cache miss
+				invalidateRow(domz);
+				domz = wrap(domz + 1);
+			}
+		}
+		refx += kx;										// shift reference coordinate accordingly
+		refz += kz;
+		domx = modulo(refx + slotx);					// restore domx - refx = slotx (mod DIM) - the loops above stop after DIM steps, so jumps
+		domz = modulo(refz + slotz);					// of DIM or more that are not a multiple of DIM leave the boundary short of the reference
+	}
+	float loadPriority(const ChunkLoadRequest& clr) {	// scheduling score of a load request against the current focus - lower loads sooner
+		float dx = (float)(clr.chunkx - focusx.load());
+		float dz = (float)(clr.chunkz - focusz.load());
+		float dist = sqrt(dx * dx + dz * dz);
+		if (dist == 0.0f) return 0.0f;
+		float align = (dx * focusdx.load() + dz * focusdz.load()) / dist;	// cosine between view direction and direction to chunk
+		float score = dist * (2.0f - align);			// chunks ahead cost their distance, chunks behind three times as much
+		return clr.chunk->visible ? score : score * CULLED_LOAD_PENALTY;
 	}
 
 	// chunk loading routine
 	void pollLoadRequests() {
+		Profiler::nameThread("chunk loader");
+		std::vector<ChunkLoadRequest> batch;
+		std::vector<ChunkLoadRequest> misses;
+		std::vector<float*> meshes;
+		batch.reserve(pool.bands());
+		misses.reserve(pool.bands());
+		meshes.reserve(pool.bands());
 		while (polling) {
-			static GLInitRequest glr;
-			if (loadQueue.empty()) std::this_thread::sleep_for(POLL_DELAY);	// poll after delay for efficiency - maybe use condition variable instead of poll delay to avoid busy waiting?
-			else {
-				//printf("generating chunk [%d, %d]\n", loadQueue.front().chunkx, loadQueue.front().chunkz);
-				loadQueue.front().chunk->chunk = Chunk(loadQueue.front().chunkx, loadQueue.front().chunkz);	// load requested chunk
-				glr.chunk = loadQueue.front().chunk;
-				initQueue.push(glr);																		// create gl init request
-				loadQueue.pop();
+			size_t waitAllocations = HeapCounter::thisThread();
+			// block until requests arrive, then take up to one request per pool thread so that a freshly invalidated row or column is generated concurrently
+			batch.clear();
+			if (!loadQueue.waitPopBest(batch, pool.bands(),
+				[this](const ChunkLoadRequest& clr) { return loadPriority(clr); },
+				[](const ChunkLoadRequest& clr) { return clr.stale(); })) break;		// queue closed - cache is shutting down
+			//printf("generating %d chunks\n", (int)batch.size());
+			PROFILE_ZONE("load batch");
+			waitAllocations = HeapCounter::thisThread() - waitAllocations;
+			size_t batchAllocations = HeapCounter::total();	// process wide while the batch runs - pool workers generate most of it
+
+			// chunks with a tile on disk are read back, the rest are generated
+			misses.clear();
+			for (ChunkLoadRequest& clr : batch) {
+				PROFILE_ZONE("read tile");
+				GLInitRequest glr;
+				if (!TILE_CACHE || !tiles.open(clr.chunkx, clr.chunkz, glr.tile)) {
+					misses.push_back(clr);
+					continue;
+				}
+				clr.chunk->chunk.restore(clr.chunkx, clr.chunkz, glr.tile.heights(), glr.tile.minHeight(), glr.tile.maxHeight());
+				submit(clr, glr);
+			}
+			meshes.clear();
+			for (size_t i = 0; i < misses.size(); i++) {
+				PROFILE_ZONE("wait for staging block");
+				float* mesh = meshArena.acquire();			// waits for the main thread to upload if every staging block is in use
+				if (!mesh) return;							// arena closed - cache is shutting down
+				meshes.push_back(mesh);
 			}
-			
+			// each chunk is generated, written to its tile and queued for upload by one pool task - tiles are written
+			// concurrently, and a chunk is uploaded as soon as its own tile is written rather than after the whole batch
+			pool.parallelFor(0, (int)misses.size(), (int)misses.size(), [this, &misses, &meshes](int first, int last) {
+				for (int i = first; i < last; i++) {
+					ChunkLoadRequest& clr = misses[i];
+					clr.chunk->chunk.generate(clr.chunkx, clr.chunkz, meshes[i]);	// load requested chunk in place
+					GLInitRequest glr;
+					glr.mesh = clr.chunk->chunk.detachMesh();
+					if (TILE_CACHE) {
+						PROFILE_ZONE("write tile");
+						tiles.write(clr.chunkx, clr.chunkz, clr.chunk->chunk, glr.mesh);	// still a valid chunk even if its slot was recycled
+					}
+					submit(clr, glr);					// the staging block may be released from here on - the tile no longer reads it
+				}
+			});
+			loadAllocations += waitAllocations + HeapCounter::total() - batchAllocations;
 		}
 	}
+	void submit(const ChunkLoadRequest& clr, GLInitRequest& glr) {	// queue a loaded chunk for upload - safe to call from any thread
+		if (clr.stale()) {								// slot was recycled while loading - result is discarded
+			recycle(glr);
+			return;
+		}
+		glr.chunk = clr.chunk;
+		glr.ticket = clr.ticket;
+		bool queued = initQueue.push(glr, [this](GLInitRequest& queued) {	// create gl init request - a full queue drops uploads of recycled slots
+			if (queued.ticket == queued.chunk->ticket) return false;
+			recycle(queued);
+			return true;
+		});
+		if (!queued) recycle(glr);						// queue closed - cache is shutting down
+	}
 
 	// instance data
 	int refx, refz;										// chunk coordinates for reference chunk - lower, leftmost chunk stored in cache grid
 	int domx, domz;										// domain boundary indices (intersection corr. with array location of reference chunk)
+	const int slotx, slotz;								// domx - refx (mod DIM) - invariant under domain shifts, so chunk (x, z) always lives in slot (x + slotx, z + slotz) mod DIM
+	BlockArena heightArena;								// height field storage of every cache slot
+	BlockArena meshArena;								// staging blocks for generated meshes awaiting upload
 	std::vector<CachedChunk> cache;						// cache matrix
-	std::queue<ChunkLoadRequest> loadQueue;				// queue of chunks to be loaded - polled by loading thread
-	std::queue<GLInitRequest> initQueue;				// queue of chunks to be initialized for opengl usage - polled by main thread
-	bool polling;										// flag that signals if load queue should be continuously polled
-	std::thread load_t;									// chunk loading thread
+	TerrainBuffers* buffers;							// GPU storage chunks are uploaded to and drawn from - nullptr if the cache runs without a GL context
+	std::vector<GLsizei> drawCounts;					// multi draw lists of valid chunks queued by draw - submitted by render
+	std::vector<const void*> drawOffsets;
+	std::vector<GLint> drawBases;
+	ConcurrentQueue<ChunkLoadRequest> loadQueue;		// queue of chunks to be loaded - consumed by loading thread. at most one live (not stale) request per slot
+	ConcurrentQueue<GLInitRequest> initQueue;			// queue of chunks to be initialized for opengl usage - polled by main thread. at most one live request per slot
+	std::atomic<bool> polling;							// flag that signals if load queue should be continuously polled
+	std::atomic<size_t> loadAllocations;				// # heap allocations made while requesting, loading and uploading chunks (see allocations)
+	std::atomic<int> focusx, focusz;					// chunk coordinate load requests are prioritized around
+	std::atomic<float> focusdx, focusdz;				// normalized XZ view direction used to prefer chunks in front of the camera
+	Frustum frustum;									// view frustum chunks are culled against - updated by focus
+	TileCache tiles;									// generated chunks persisted to disk - read by the loading thread, written by the pool tasks generating them
+	double uploadBudget;								// seconds per frame pollInitRequests may spend uploading chunks
+	ThreadPool& pool;									// shared worker pool used for chunk generation
+	std::thread load_t;									// chunk loading thread - dispatches load requests to the pool
 
 public:
 
 	// Constructor
 	// Defines a matrix of loaded chunks beginning at reference chunk coordinate (referencex, referencez)
-	Cache(int referencex = 0, int referencez = 0) :
-		POLL_DELAY(POLL_DELAY_MILLIS), refx(referencex), refz(referencez), domx(0), domz(0), polling(true)
+	// chunks are uploaded to and drawn from gpu, which must hold at least volume() slots - pass nullptr to run without a GL context
+	// generated chunks are persisted as tiles in tileDirectory - pass an empty string to disable the tile cache
+	Cache(int referencex = 0, int referencez = 0, TerrainBuffers* gpu = nullptr, const std::string& tileDirectory = "chunkcache") :
+		refx(referencex), refz(referencez), domx(0), domz(0), slotx(modulo(-referencex)), slotz(modulo(-referencez)),
+		heightArena(Chunk::heightElements(), CACHE_VOLUME), meshArena(Chunk::meshElements(), STAGING_BLOCKS), cache(CACHE_VOLUME),
+		buffers(gpu), loadQueue(CACHE_VOLUME), initQueue(CACHE_VOLUME), polling(true), loadAllocations(0),
+		focusx(referencex + DIM / 2), focusz(referencez + DIM / 2), focusdx(0.0f), focusdz(0.0f),
+		tiles(tileDirectory), uploadBudget(UPLOAD_BUDGET_MILLIS / 1000.0), pool(ThreadPool::shared())
 	{
-		// compute shared resources for chunk objects
-		Chunk::computeSharedResources();
+		drawCounts.reserve(CACHE_VOLUME);
+		drawOffsets.reserve(CACHE_VOLUME);
+		drawBases.reserve(CACHE_VOLUME);
+		for (CachedChunk& cc : cache) cc.chunk.attach(heightArena.acquire());
 		
-		// allocate cache matrix
-		cache.reserve(CACHE_VOLUME);
-		for (int y = 0; y < DIM; y++) {
-			for (int x = 0; x < DIM; x++) {
-				CachedChunk cc;
-				cache.push_back(cc);
-			}
-		}
-
 		// preload entire cache if enabled - COMPUTATIONALLY EXPENSIVE and SPACE INTENSIVE
 		// this is done on the main thread and will block until completed
 		if (CACHE_PRELOAD) {
 			printf("Preloading cache of volume %d ... ", CACHE_VOLUME);
-			double time = glfwGetTime();
-			int cx = refx, cz = refz;
-			int i;
-			for (int y = 0; y < DIM; y++) {
-				for (int x = 0; x < DIM; x++) {
-					i = index(x,y);
-					cache[i].chunk = Chunk(cx, cz);
-					cache[i].chunk.glLoad();
+			double time = now();
+			for (int group = 0; group < CACHE_VOLUME; group += STAGING_BLOCKS) {		// generate as many chunks at once as there are staging blocks
+				int end = std::min(group + STAGING_BLOCKS, CACHE_VOLUME);
+				pool.parallelFor(group, end, [this](int first, int last) {
+					for (int i = first; i < last; i++) cache[i].chunk.generate(refx + i % DIM, refz + i / DIM, meshArena.acquire());
+				});
+				for (int i = group; i < end; i++) {
+					float* mesh = cache[i].chunk.detachMesh();
+					glLoad(cache[i], mesh);
+					meshArena.release(mesh);
+					cache[i].chunkx = refx + i % DIM;
+					cache[i].chunkz = refz + i / DIM;
 					cache[i].status = CACHESTATUS::VALID;
-					cx++;
 				}
-				cx = refx;
-				cz++;
 			}
-			time = glfwGetTime() - time;
+			time = now() - time;
 			printf("done - %fs.\n", time);
 		}
 
@@ -150,10 +338,12 @@ public:
 	// Destructor - clean up cache load thread
 	~Cache() {
 		polling = false;
+		loadQueue.close();						// wake the loading thread so it can observe shutdown
+		initQueue.close();
+		meshArena.close();
 		load_t.join();
-
-		// free shared chunk resources
-		Chunk::freeSharedResources();
+		GLInitRequest glr;
+		while (initQueue.tryPop(glr)) recycle(glr);	// unmap tiles that were never uploaded
 	}
 
 	// delete copy constructor, copy assignment operator, and move constructor
@@ -164,70 +354,139 @@ public:
 	// cache dimension
 	static constexpr int dim() { return DIM; }
 
+	// # chunks cached at once - the # slots the terrain buffers lent to the cache must hold
+	static constexpr int volume() { return CACHE_VOLUME; }
+
+	// set the chunk coordinate and view that pending chunk loads are prioritized around and chunks are culled against
+	// call once per frame before drawing - projectionView is the camera's projection * view matrix
+	void focus(int chunkx, int chunkz, const glm::vec3& forward, const glm::mat4& projectionView) {
+		frustum.update(projectionView);
+		focusx = chunkx;
+		focusz = chunkz;
+		float len = sqrt(forward.x * forward.x + forward.z * forward.z);
+		focusdx = len > 0.0f ? forward.x / len : 0.0f;
+		focusdz = len > 0.0f ? forward.z / len : 0.0f;
+	}
+
 	// chunk initialization routine - call this once per render loop from gl context thread
-	void pollInitRequests() {
-		if (!initQueue.empty()) {
-			initQueue.front().chunk->chunk.glLoad();
-			initQueue.front().chunk->status = CACHESTATUS::VALID;
-			initQueue.pop();
+	// uploads generated chunks until the per frame upload budget is spent (at least one chunk is uploaded if any are ready)
+	// returns the number of chunks uploaded
+	int pollInitRequests() {
+		PROFILE_ZONE("Cache::pollInitRequests");
+		size_t allocationsBefore = HeapCounter::thisThread();
+		GLInitRequest glr;
+		int uploaded = 0;
+		double start = now();
+		while ((uploaded == 0 || now() - start < uploadBudget) && initQueue.tryPop(glr)) {
+			if (glr.ticket != glr.chunk->ticket) {				// slot was recycled after generation - skip the upload
+				recycle(glr);
+				continue;
+			}
+			glLoad(*glr.chunk, glr.data());
+			recycle(glr);
+			glr.chunk->status = CACHESTATUS::VALID;
+			uploaded++;
 		}
+		loadAllocations += HeapCounter::thisThread() - allocationsBefore;
+		return uploaded;
 	}
 
-	// gets approximate height at given world coordinate and containing chunk coordinate
-	float getHeight(int cx, int cz, float wx, float wy) {
-		int distx = cx - refx;					// compute distance from reference point in chunk space
-		int distz = cz - refz;
-		int index_x = wrap(domx + distx);		// compute corresponding cache matrix index as distance from domain boundaries
-		int index_z = wrap(domz + distz);
-		return cache[index(index_x, index_z)].chunk.getHeight(wx, wy);	// use cache coordinates to find containing chunk for test point and return approx height at that world coordinate
+	// set the time per frame pollInitRequests may spend uploading chunks to the GPU
+	void setUploadBudget(double millis) {
+		uploadBudget = millis / 1000.0;
 	}
 
-	// draw chunk at specified chunk coordinate
-	// Appropriate shader must be setup prior to calling this method
-	void draw(int chunkx, int chunkz, Shader& terrainShader, Shader& waterShader) {
-		int distx = chunkx - refx;					// compute distance from reference point in chunk space
-		int distz = chunkz - refz;
-		if (distx < -1 || distx > DIM || distz < -1 || distz > DIM) {
-			printf("INVALID CHUNK COORDINATE [%d, %d] PROVIDED. CACHE COORDINATE MUST NOT EXCEED 1 PAST THE EXISTING CACHE BOUNDARIES.\n", chunkx, chunkz);
-			exit(EXIT_FAILURE);
-		}
+	// number of generated chunks waiting to be uploaded to the GPU
+	int pendingUploads() const {
+		return (int)initQueue.size();
+	}
 
-		int index_x = wrap(domx + distx);			// compute corresponding cache matrix index as distance from domain boundaries
-		int index_z = wrap(domz + distz);
+	// total # heap allocations made by chunk loading since construction - on the main thread requesting and uploading chunks,
+	// and process wide while the loading thread reads, generates and writes a batch (so pool workers are included, as is
+	// anything other threads allocate meanwhile). stops growing once flight reaches a steady state, apart from the
+	// occasional tile directory trim (see TileCache). always 0 unless built with COUNT_HEAP_ALLOCATIONS (see HeapCounter)
+	size_t allocations() const {
+		return loadAllocations;
+	}
 
-		if (distx < 0) {						// west cache miss
-			domx = wrap(domx - 1);		// shift horizontal domain boundary line
-			refx--;						// shift reference coordinate accordingly
-			invalidateColumn(domx);		// invalidate old chunk data
-		}
-		else if (distx >= DIM) {				// east cache miss
-			domx = wrap(domx + 1);
-			refx++;
-			invalidateColumn(wrap(domx - 1));
-		}
-		if (distz < 0) {						// south cache miss
-			domz = wrap(domz - 1);
-			refz--;
-			invalidateRow(domz);
+	// total # heap allocations made for chunk storage arenas - constant after construction
+	size_t storageAllocations() const {
+		return BlockArena::allocations();
+	}
+
+	// total # chunks generated since construction
+	size_t chunksGenerated() const {
+		return meshArena.acquisitions();
+	}
+
+	// gets the height of the rendered terrain surface at the given world coordinate - safe to call from any thread, concurrently with loading
+	// the containing chunk is resolved through the cache. if it is not loaded (or is being regenerated) a cheap estimate is returned instead
+	float getHeight(float wx, float wz) const {
+		float h;
+		return tryHeight(wx, wz, h) ? h : Chunk::estimateHeight(wx, wz);
+	}
+
+	// batched getHeight - out[i] = getHeight(wx[i], wz[i]). points outside of valid chunks are estimated from noise in batches
+	void getHeights(const float* wx, const float* wz, float* out, int count) const {
+		float missx[MISS_BATCH], missz[MISS_BATCH], missh[MISS_BATCH];
+		int missi[MISS_BATCH];
+		int misses = 0;
+		for (int i = 0; i < count; i++) {
+			if (tryHeight(wx[i], wz[i], out[i])) continue;
+			missx[misses] = wx[i];
+			missz[misses] = wz[i];
+			missi[misses++] = i;
+			if (misses == MISS_BATCH) {
+				Chunk::estimateHeights(missx, missz, missh, misses);
+				for (int m = 0; m < misses; m++) out[missi[m]] = missh[m];
+				misses = 0;
+			}
 		}
-		else if (distz >= DIM) {				// north cache miss
-			domz = wrap(domz + 1);
-			refz++;
-			invalidateRow(wrap(domz - 1));
+		if (misses > 0) {
+			Chunk::estimateHeights(missx, missz, missh, misses);
+			for (int m = 0; m < misses; m++) out[missi[m]] = missh[m];
 		}
+	}
+
+	// queue chunk at specified chunk coordinate for drawing at the given level of detail - queued chunks are drawn together by render()
+	void draw(int chunkx, int chunkz, int lod) {
+		PROFILE_ZONE("Cache::draw");
+		contain(chunkx, chunkz);					// shift cache domain over the requested chunk if necessary
+		int index_x = wrap(domx + chunkx - refx);	// compute corresponding cache matrix index as distance from domain boundaries
+		int index_z = wrap(domz + chunkz - refz);
 		CachedChunk& cc = cache[index(index_x, index_z)];
-		if (cc.status == CACHESTATUS::VALID) {						// draw valid cached chunk
-			cc.chunk.draw(/*terrainShader, waterShader*/);
+		if (cc.status == CACHESTATUS::VALID) cc.visible = frustum.intersects(cc.chunk.boundsMin(), cc.chunk.boundsMax());	// test exact bounds once generated
+		else cc.visible = frustum.intersects(Chunk::boundsMin(chunkx, chunkz), Chunk::boundsMax(chunkx, chunkz));			// otherwise the terrain height limits - culled chunks still load, after visible ones
+		if (cc.status == CACHESTATUS::VALID) {						// queue visible valid cached chunk for drawing
+			if (!cc.visible) return;
+			drawCounts.push_back(Chunk::indexCount(lod));
+			drawOffsets.push_back(Chunk::indexOffset(lod));
+			drawBases.push_back(Chunk::baseVertex(slot(cc)));
 		}
 		else if (cc.status == CACHESTATUS::INVALID) {				// request this chunk to be loaded into cache, then fail the draw gracefully
 			cc.status = CACHESTATUS::QUEUED;						// this way the chunk will be drawn when it is ready without causing massive lag and frame drops
+			cc.chunkx = chunkx;
+			cc.chunkz = chunkz;
 			ChunkLoadRequest clr;
 			clr.chunk = &cc;
+			clr.ticket = cc.ticket;
 			clr.chunkx = chunkx;
 			clr.chunkz = chunkz;
-			loadQueue.push(clr);
+			size_t allocationsBefore = HeapCounter::thisThread();
+			loadQueue.push(clr, [](const ChunkLoadRequest& queued) { return queued.stale(); });	// a full queue drops requests for recycled slots - never blocks
+			loadAllocations += HeapCounter::thisThread() - allocationsBefore;
 		}
 	}
+
+	// draws every chunk queued by draw since the last call with a single multi draw call
+	// Appropriate shader must be setup prior to calling this method
+	void render() {
+		PROFILE_ZONE("Cache::render");
+		if (buffers) buffers->draw(drawCounts.data(), drawOffsets.data(), drawBases.data(), (int)drawCounts.size());
+		drawCounts.clear();
+		drawOffsets.clear();
+		drawBases.clear();
+	}
 };
 
 #endif
\ No newline at end of file
@@ -2,16 +2,34 @@
 #define CS3P98_TERRAIN_CHUNK_H
 
 #include "shader.h"
+#include "noise.h"
+#include "profiler.h"
+#include "threadpool.h"
 #include <glad/glad.h>		// OpenGL function pointers
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/noise.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
 #include <iostream>
-#include <thread>
+#include <limits>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 
 // uncomment to draw chunk borders
 //#define DRAW_CHUNK_BORDERS
 
+// uncomment to upload compact 8 byte terrain vertices [16 bit height, 2 x 16 bit octahedral normal] instead of 16 byte
+// float vertices [float height, 3 float normal] - in both formats XZ position and texture coords are reconstructed in the vertex shader
+//#define COMPACT_CHUNK_VERTICES
+
+// uncomment to compute vertex normals by finite differences of neighbouring heights instead of analytic noise derivatives
+//#define FINITE_DIFFERENCE_NORMALS
+
+// uncomment to draw chunks as indexed triangle lists instead of triangle strips with primitive restart
+//#define CHUNK_TRIANGLE_LISTS
+
 /*
 	Simplified Terrain Chunk Class
 	One terrain chunk represents a square grid of terrain oriented along the horizontal XZ plane in world space
@@ -22,7 +40,11 @@ class Chunk {
 private:
 
 	// class constants
-	static constexpr int	STRIDE		= 8;							// stride for mesh data - # components per vertex [3 position, 3 normal, 2 tex]
+#ifdef COMPACT_CHUNK_VERTICES
+	static constexpr int	STRIDE		= 2;							// stride for mesh data - # floats per vertex [u16 height, u16 padding, 2 x i16 octahedral normal]
+#else
+	static constexpr int	STRIDE		= 3;							// stride for mesh data - # floats per vertex [3 normal]. heights are uploaded from the height field, XZ and texture coords are derived in the vertex shader
+#endif
 	static constexpr int	CHUNK_WIDTH = 256;							// chunk consumes a square width by width grid in world space - MAKE POWER OF 2 - 1 => Default 1000
 	static constexpr float  SCALE		= 4.0f;							// width of one cell in world space - SHOULD DIVIDE CHUNK_WIDTH EVENLY [LARGER = BETTER PERFORMANCE & WORSE DETAIL]
 	static constexpr float	DENSITY		= 1.0f / SCALE;					// determines poly density in terrain chunk mesh - inversely proportional to cell scale (> 1 = smaller cells = more polys in mesh)
@@ -31,258 +53,486 @@ private:
 	static constexpr float	TEX_SCALE	= 2.0f;							// width of texture used in world space	- SHOULD DIVIDE CHUNK_WIDTH EVENLY	
 	static constexpr float	MAX_AMPLITUDE = 14.3f;						// maximum height or depth of terrain
 	static constexpr float	FREQUENCY	= 0.003;//0.0005f;				// terrain variance scaling factor
-	static int*				chunk_index;								// index array for all chunk objects
+	static constexpr int	OCTAVES		= 6;							// # noise octaves summed per height sample
+	static constexpr float	OCTAVE_FREQUENCY[OCTAVES] = { 1.0f, 1.93f, 4.07f, 7.91f, 16.1f, 32.07f };	// frequency multiplier of each octave
+	static constexpr float	OCTAVE_WEIGHT[OCTAVES] = { 1.0f, 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };	// amplitude of each octave
+	static constexpr int	ESTIMATE_OCTAVES = 2;						// # leading octaves summed by estimateHeight
+	static constexpr int	BATCH		= 64;							// # samples evaluated per batched noise pass
+	static constexpr int	LOD_LEVELS	= 4;							// # levels of detail - level l draws cells of (2^l x 2^l) quads. 2^(LOD_LEVELS-1) MUST DIVIDE DIM
+	static_assert(DIM % (1 << (LOD_LEVELS - 1)) == 0, "coarsest level of detail must divide the chunk grid evenly");
+	static constexpr int	STRIP_BAND	= 8;							// # cell rows covered by one strip - short strips keep the previous column's vertices in the post-transform vertex cache
+	static constexpr int	VERTEX_CACHE = 24;							// post-transform vertex cache size assumed when reporting vertex shader invocations
+	typedef std::conditional<(VDIM * VDIM < 0xFFFF), unsigned short, unsigned int>::type Index;	// narrowest index type that can address every vertex of a chunk (the maximum value is reserved for primitive restart)
+	static constexpr GLenum	INDEX_TYPE	= sizeof(Index) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	static constexpr Index	RESTART		= (Index)~(Index)0;				// primitive restart index
+#ifdef CHUNK_TRIANGLE_LISTS
+	static constexpr GLenum	PRIMITIVE	= GL_TRIANGLES;
+#else
+	static constexpr GLenum	PRIMITIVE	= GL_TRIANGLE_STRIP;
+#endif
+	static int				lod_first[LOD_LEVELS];						// first index of each level of detail in the index array
+	static int				lod_count[LOD_LEVELS];						// # indices of each level of detail
 	static unsigned int		ebo;
+	static constexpr int	MESH_FORMAT = 0								// identifies the mesh data layout and normal method selected above
+#ifdef COMPACT_CHUNK_VERTICES
+		| 1
+#endif
+#ifdef FINITE_DIFFERENCE_NORMALS
+		| 2
+#endif
+#ifdef DRAW_CHUNK_BORDERS
+		| 4
+#endif
+		;
+	static constexpr int	ORIGIN_TEXTURE_UNIT = 3;					// texture unit the per slot chunk origins are bound to
 
 	// compile time helper functions
-	static constexpr int numVertices() { return VDIM * VDIM; }
-	static constexpr int vertexElements() { return 3 * numVertices(); }
-	static constexpr int meshElements() { return STRIDE * numVertices(); }
 	static constexpr int numTriangles() { return 2 * DIM * DIM; }
 	static constexpr int indexElements() { return 3 * numTriangles(); }
 	static constexpr float boundaryOffset() { return SCALE * DIM / 2.0f; }
+	static inline float origin(int chunkcoord) {							// world coord of the lower leftmost vertex of a chunk along one axis
+		return (float)(int)(CHUNK_WIDTH * chunkcoord) - boundaryOffset();	// chunk coord maps to the centre of the chunk
+	}
 	static constexpr float texIncrement() { return SCALE / TEX_SCALE; }
+	static constexpr float octaveWeightSum(int o = 1) { return o < OCTAVES ? OCTAVE_WEIGHT[o] + octaveWeightSum(o + 1) : 0.0f; }
 
 	// helper functions
-	static void initIndexArray() {
-		chunk_index = new int[indexElements()];
+	static inline int vertexIndex(int x, int z) { return z * VDIM + x; }
+	static inline int lodStep(int lod) { return 1 << lod; }
+	static void emitFan(std::vector<Index>& out, int x0, int z0, int s) {				// triangulate one (s x s) cell touching the chunk boundary as a fan around the cell centre
+		bool south = z0 == 0, east = x0 + s == DIM, north = z0 + s == DIM, west = x0 == 0;
+
+		// walk the cell perimeter counter clockwise starting at the lower left corner
+		int perimeter[4 * DIM + 1];
+		int n = 0;
+		for (int i = 0; i < s; i += south ? 1 : s) perimeter[n++] = vertexIndex(x0 + i, z0);
+		for (int i = 0; i < s; i += east ? 1 : s) perimeter[n++] = vertexIndex(x0 + s, z0 + i);
+		for (int i = 0; i < s; i += north ? 1 : s) perimeter[n++] = vertexIndex(x0 + s - i, z0 + s);
+		for (int i = 0; i < s; i += west ? 1 : s) perimeter[n++] = vertexIndex(x0, z0 + s - i);
+		perimeter[n] = perimeter[0];
+		Index centre = (Index)vertexIndex(x0 + s / 2, z0 + s / 2);
+#ifdef CHUNK_TRIANGLE_LISTS
+		for (int i = 0; i < n; i++) {
+			out.push_back(centre);
+			out.push_back((Index)perimeter[i]);
+			out.push_back((Index)perimeter[i + 1]);
+		}
+#else
+		for (int i = n; i > 0; i--) {													// walk the perimeter backwards, interleaving the centre - every other triangle is degenerate
+			out.push_back((Index)perimeter[i]);
+			out.push_back(centre);
+		}
+		out.push_back((Index)perimeter[0]);
+		out.push_back(RESTART);
+#endif
+	}
+	static void emitGrid(std::vector<Index>& out, int x0, int z0, int x1, int z1, int s) {	// triangulate the (s x s) cells covering [x0, x1) x [z0, z1)
 		/*
-			generate triangle indices (with CCW winding)
+			Cells are split into two triangles along the same anti-diagonal (a-b) with CCW winding:
 
 				b --- d		<- (a,b,c,d) are cell vertices relative to current cell
 				|  \  |
 				c --- a
+
+			Cells are visited column by column within bands of STRIP_BAND rows, so the vertices shared with the previous
+			column are still in the post-transform vertex cache when they are reused. As a strip, every column of a band
+			is [c, a, b, d, ...] - the strip's alternating winding yields exactly the triangles (a,b,c) and (a,d,b).
 		*/
-		int index = 0;
-		int a = 0, b = 0, c = 0, d = 0;
-		for (unsigned int y = 0; y < DIM; y++) {	// iterate cells
-			for (unsigned int x = 0; x < DIM; x++) {
-				// compute vertex indices
-				c = y * VDIM + x;
-				a = c + 1;
-				b = c + VDIM;
-				d = a + VDIM;
-				// add indices for triangle 1 and 2
-				chunk_index[index++] = a;
-				chunk_index[index++] = b;
-				chunk_index[index++] = c;
-				chunk_index[index++] = a;
-				chunk_index[index++] = d;
-				chunk_index[index++] = b;
+		for (int zb = z0; zb < z1; zb += STRIP_BAND * s) {
+			int ze = std::min(zb + STRIP_BAND * s, z1);
+			for (int x = x0; x < x1; x += s) {
+#ifdef CHUNK_TRIANGLE_LISTS
+				for (int z = zb; z < ze; z += s) {
+					Index c = (Index)vertexIndex(x, z), a = (Index)vertexIndex(x + s, z);
+					Index b = (Index)vertexIndex(x, z + s), d = (Index)vertexIndex(x + s, z + s);
+					out.push_back(a);
+					out.push_back(b);
+					out.push_back(c);
+					out.push_back(a);
+					out.push_back(d);
+					out.push_back(b);
+				}
+#else
+				for (int z = zb; z <= ze; z += s) {
+					out.push_back((Index)vertexIndex(x, z));
+					out.push_back((Index)vertexIndex(x + s, z));
+				}
+				out.push_back(RESTART);
+#endif
 			}
 		}
 	}
+	static void emitLevel(std::vector<Index>& out, int lod) {							// triangulate the whole chunk grid at the given level of detail
+		/*
+			Cells touching the chunk boundary keep every full resolution vertex along their boundary sides and are drawn
+			as a fan around the cell centre. Chunk edges are therefore identical at every level of detail, so neighbouring
+			chunks drawn at different levels never crack.
+		*/
+		int s = lodStep(lod);
+		if (s == 1) {
+			emitGrid(out, 0, 0, DIM, DIM, 1);
+			return;
+		}
+		emitGrid(out, s, s, DIM - s, DIM - s, s);										// interior cells
+		for (int x = 0; x < DIM; x += s) emitFan(out, x, 0, s);							// boundary ring - south
+		for (int z = s; z < DIM; z += s) emitFan(out, DIM - s, z, s);					// east
+		for (int x = DIM - 2 * s; x >= 0; x -= s) emitFan(out, x, DIM - s, s);			// north
+		for (int z = DIM - 2 * s; z >= s; z -= s) emitFan(out, 0, z, s);				// west
+	}
+	static std::vector<Index> initIndexArray() {										// index array holds the triangles of every level of detail back to back
+		std::vector<Index> indices;
+		for (int lod = 0; lod < LOD_LEVELS; lod++) {
+			lod_first[lod] = (int)indices.size();
+			emitLevel(indices, lod);
+			lod_count[lod] = (int)indices.size() - lod_first[lod];
+		}
+		return indices;
+	}
 	static void computeSharedResources() {												// generate and link shared chunk data - call from main thread
 		// compute mesh element index array
-		initIndexArray();
+		std::vector<Index> indices = initIndexArray();
 		glGenBuffers(1, &ebo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexElements() * sizeof(int), chunk_index, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(Index), indices.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		delete[] chunk_index;			// no longer need index array in memory
 	}
 	static void freeSharedResources() {													// cleanup shared chunk data - call from main thread
 		glDeleteBuffers(1, &ebo);
 	}
-	void glLoad() {																		// prepare object for rendering with opengl - only call this on thread associated with opengl context
-		// setup GL buffers
+	static constexpr GLsizeiptr bufferSize(int slots) {								// byte size of a chunk buffer for the given # slots
+#ifdef COMPACT_CHUNK_VERTICES
+		return (GLsizeiptr)slots * meshElements() * sizeof(float);
+#else
+		return (GLsizeiptr)slots * (heightElements() + meshElements()) * sizeof(float);	// [heights of every slot][normals of every slot]
+#endif
+	}
+	static void createBuffers(unsigned int& vao, unsigned int& vbo, int slots) {		// allocate a long lived vertex array and buffer holding the meshes of slots chunks back to back - call from main thread
 		glGenVertexArrays(1, &vao);
 		glGenBuffers(1, &vbo);
 
 		glBindVertexArray(vao);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, meshElements() * sizeof(float), mesh, GL_STATIC_DRAW);		// upload mesh data to graphics card
+		glBufferData(GL_ARRAY_BUFFER, bufferSize(slots), nullptr, GL_DYNAMIC_DRAW);	// storage is reused for every chunk loaded into a slot
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);													// bind EBO that was already uploaded to GPU
 
-		glEnableVertexAttribArray(0);			// position attribute
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1);			// normal attribute
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(2);			// texture attribute
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)(6 * sizeof(float)));
-
-		// mesh data unnecessary after GPU upload
-		delete[] mesh;
-		mesh = nullptr;
+#ifdef COMPACT_CHUNK_VERTICES
+		glEnableVertexAttribArray(0);			// height attribute
+		glVertexAttribPointer(0, 1, GL_UNSIGNED_SHORT, GL_TRUE, STRIDE * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);			// octahedral normal attribute
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, STRIDE * sizeof(float), (void*)(2 * sizeof(short)));
+#else
+		glEnableVertexAttribArray(0);			// height stream
+		glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);			// normal stream - follows the heights of every slot
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, STRIDE * sizeof(float), (void*)((GLsizeiptr)slots * heightElements() * sizeof(float)));
+#endif
+		glBindVertexArray(0);
 	}
-	inline float computeHeight(float x, float z) {										// compute and return height at specified XZ plane coordinate in world space
-		glm::vec2 coord(x, z);															// https://www.redblobgames.com/maps/terrain-from-noise/
-		coord *= FREQUENCY;
-		float elevation =
-		(glm::simplex(coord) + 1) +							// apply common frequency scale to all octaves
-		0.5f * (glm::simplex(1.93f * coord)) +
-		0.25f * (glm::simplex(4.07f * coord)) +
-		0.125f * (glm::simplex(7.91f * coord)) +
-		0.0625f * (glm::simplex(16.1f * coord)) +
-		0.03125f * (glm::simplex(32.07f * coord));
+	static void deleteBuffers(unsigned int& vao, unsigned int& vbo) {						// free buffers created by createBuffers - call from main thread
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &vbo);
+		vao = 0;
+		vbo = 0;
+	}
+	void glLoad(unsigned int vbo, int slots, int slot, const float* mesh) {			// refill a slot of a chunk buffer (of the given # slots) with this chunk's heights and mesh data written by generate - only call this on thread associated with opengl context
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+#ifdef COMPACT_CHUNK_VERTICES
+		(void)slots;																	// one interleaved stream - slots are addressed by slot alone
+		glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)slot * meshElements() * sizeof(float), meshElements() * sizeof(float), mesh);	// upload mesh data to graphics card in place
+#else
+		glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)slot * heightElements() * sizeof(float), heightElements() * sizeof(float), height);	// upload height stream in place
+		glBufferSubData(GL_ARRAY_BUFFER, ((GLintptr)slots * heightElements() + (GLintptr)slot * meshElements()) * sizeof(float), meshElements() * sizeof(float), mesh);	// upload normal stream in place
+#endif
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	static void createOrigins(unsigned int& buffer, unsigned int& texture, int slots) {	// allocate a texture buffer holding the world space XZ origin of the chunk in each slot - call from main thread
+		glGenBuffers(1, &buffer);
+		glGenTextures(1, &texture);
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)slots * 2 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+	static void deleteOrigins(unsigned int& buffer, unsigned int& texture) {				// free buffers created by createOrigins - call from main thread
+		glDeleteTextures(1, &texture);
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		texture = 0;
+	}
+	void glLoadOrigin(unsigned int buffer, int slot) {									// record this chunk's origin for its slot - call from main thread alongside glLoad
+		float origin[2] = { worldx, worldz };
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, (GLintptr)slot * sizeof(origin), sizeof(origin), origin);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+#ifdef COMPACT_CHUNK_VERTICES
+	void packVertex(int index, float height, const glm::vec3& norm) {					// write a compact vertex at mesh float index - height is quantized over the terrain height limits
+		unsigned short* h = reinterpret_cast<unsigned short*>(mesh + index);
+		short* n = reinterpret_cast<short*>(mesh + index) + 2;
+		float t = (height - minTerrainHeight()) / (maxTerrainHeight() - minTerrainHeight());
+		h[0] = (unsigned short)(glm::clamp(t, 0.0f, 1.0f) * 65535.0f + 0.5f);
+		h[1] = 0;
+		float l1 = fabs(norm.x) + fabs(norm.y) + fabs(norm.z);							// octahedral encoding with y as the up axis - https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+		float ox = norm.x / l1;
+		float oz = norm.z / l1;
+		if (norm.y < 0.0f) {															// fold lower hemisphere
+			float fx = (1.0f - fabs(oz)) * (ox >= 0.0f ? 1.0f : -1.0f);
+			float fz = (1.0f - fabs(ox)) * (oz >= 0.0f ? 1.0f : -1.0f);
+			ox = fx;
+			oz = fz;
+		}
+		n[0] = (short)roundf(glm::clamp(ox, -1.0f, 1.0f) * 32767.0f);
+		n[1] = (short)roundf(glm::clamp(oz, -1.0f, 1.0f) * 32767.0f);
+	}
+#endif
+	static inline float shapeHeight(float elevation) {									// maps summed noise octaves to a world space height
 		elevation /= 1.5f;
-		elevation = (float)pow(elevation, 2);
+		elevation = elevation * elevation;
 		return MAX_AMPLITUDE * elevation - MAX_AMPLITUDE / 4;
-		//return (float)(cos(0.7 * (double)x)); - test sinusoidal heightmap
 	}
-	void generateMeshData(unsigned int startz, unsigned int endz, float worldx, float worldz, float startTexV) {
-		// generate mesh data
-		float px = worldx;
+	static inline float shapeSlope(float elevation) {									// derivative of shapeHeight with respect to elevation
+		return 2.0f * MAX_AMPLITUDE * elevation / (1.5f * 1.5f);
+	}
+	template <bool Gradient>
+	static void heightBatch(const float* x, const float* z, float* out, float* dhdx, float* dhdz, int count, int octaves = OCTAVES) {	// fewer octaves sum the leading octaves only (see estimateHeight)
+		float cx[BATCH], cz[BATCH], ox[BATCH], oz[BATCH], n[BATCH], nx[BATCH], nz[BATCH];
+		for (int first = 0; first < count; first += BATCH) {
+			int len = count - first < BATCH ? count - first : BATCH;
+			for (int i = 0; i < len; i++) {
+				cx[i] = x[first + i] * FREQUENCY;
+				cz[i] = z[first + i] * FREQUENCY;
+			}
+			float* elevation = out + first;
+			float* ex = Gradient ? dhdx + first : nullptr;								// elevation gradient in noise space - scaled to world space below
+			float* ez = Gradient ? dhdz + first : nullptr;
+			if (Gradient) Noise::simplex(cx, cz, elevation, ex, ez, len);
+			else Noise::simplex(cx, cz, elevation, len);
+			for (int i = 0; i < len; i++) elevation[i] += 1;
+			for (int o = 1; o < octaves; o++) {
+				for (int i = 0; i < len; i++) {
+					ox[i] = OCTAVE_FREQUENCY[o] * cx[i];
+					oz[i] = OCTAVE_FREQUENCY[o] * cz[i];
+				}
+				if (Gradient) {
+					Noise::simplex(ox, oz, n, nx, nz, len);
+					for (int i = 0; i < len; i++) {
+						ex[i] += OCTAVE_WEIGHT[o] * OCTAVE_FREQUENCY[o] * nx[i];
+						ez[i] += OCTAVE_WEIGHT[o] * OCTAVE_FREQUENCY[o] * nz[i];
+					}
+				}
+				else Noise::simplex(ox, oz, n, len);
+				for (int i = 0; i < len; i++) elevation[i] += OCTAVE_WEIGHT[o] * n[i];
+			}
+			if (Gradient) {
+				for (int i = 0; i < len; i++) {												// chain rule through the frequency scale and shapeHeight
+					float slope = FREQUENCY * shapeSlope(elevation[i]);
+					ex[i] *= slope;
+					ez[i] *= slope;
+				}
+			}
+			for (int i = 0; i < len; i++) elevation[i] = shapeHeight(elevation[i]);
+		}
+	}
+	template <bool Gradient>
+	static void heightRow(float x, float z, float step, float* out, float* dhdx, float* dhdz, int count) {
+		float px[BATCH], pz[BATCH];
+		for (int i = 0; i < BATCH; i++) pz[i] = z;
+		for (int first = 0; first < count; first += BATCH) {
+			int len = count - first < BATCH ? count - first : BATCH;
+			for (int i = 0; i < len; i++) {
+				px[i] = x;
+				x += step;
+			}
+			heightBatch<Gradient>(px, pz, out + first, Gradient ? dhdx + first : nullptr, Gradient ? dhdz + first : nullptr, len);
+		}
+	}
+	inline void storeNormal(unsigned int index, int x, int z, float py, glm::vec3 norm) {	// write the normal of vertex (x, z) starting at mesh float index
+#ifdef DRAW_CHUNK_BORDERS
+		if (x == 0 || x == DIM || z == 0 || z == DIM) norm *= -1;						// invert normal to show chunk borders
+#else
+		(void)x;
+		(void)z;
+#endif
+#ifdef COMPACT_CHUNK_VERTICES
+		packVertex(index, py, norm);
+#else
+		(void)py;																		// heights are uploaded from the height field
+		mesh[index] = norm.x;
+		mesh[index + 1] = norm.y;
+		mesh[index + 2] = norm.z;
+#endif
+	}
+	void generateMeshData(unsigned int startz, unsigned int endz, float worldx, float worldz, float& bandMin, float& bandMax) {
+		// generate mesh data - vertex normals come out of the same pass, so bands are independent of each other
+#ifdef FINITE_DIFFERENCE_NORMALS
+		float band[VDIM + 2][VDIM + 2];													// heights of this band's rows with a one vertex halo on every side - band[z - startz + 1][x + 1]
+		for (unsigned int z = startz; z < endz + 2; z++) computeHeightRow(worldx - SCALE, worldz + SCALE * ((int)z - 1), SCALE, band[z - startz], VDIM + 2);
+#else
+		float heights[VDIM];
+		float dhdx[VDIM], dhdz[VDIM];
+#endif
 		float py = 0.0f;
 		float pz = worldz + (SCALE * startz);
-		float tu = 0, tv = startTexV;
-		unsigned int index = VDIM * startz;
-		unsigned int vindex = 3 * index;
-		index *= STRIDE;
+		unsigned int hindex = VDIM * startz;
+		unsigned int index = STRIDE * hindex;
+		bandMin = std::numeric_limits<float>::max();
+		bandMax = std::numeric_limits<float>::lowest();
 		for (unsigned int y = startz; y < endz; y++) {
+#ifdef FINITE_DIFFERENCE_NORMALS
+			const float* heights = band[y - startz + 1] + 1;
+#else
+			computeHeightRow(worldx, pz, SCALE, heights, dhdx, dhdz, VDIM);		// compute vertex heights and their gradients for the whole row at once
+#endif
 			for (unsigned int x = 0; x < VDIM; x++) {
-				// store vertex positions
-				py = computeHeight(px, pz);		// compute vertex height via noise or other method here
-				mesh[index++] = px;
-				mesh[index++] = py;
-				mesh[index++] = pz;
-				vertex[vindex++] = px;
-				vertex[vindex++] = py;
-				vertex[vindex++] = pz;
-				index += 3;						// skip normal component for now
-				mesh[index++] = tu;
-				mesh[index++] = tv;
-				px += SCALE;
-				tu += texIncrement();
+				// store vertex heights
+				py = heights[x];
+				height[hindex++] = py;
+				bandMin = std::min(bandMin, py);
+				bandMax = std::max(bandMax, py);
+#ifdef FINITE_DIFFERENCE_NORMALS
+				storeNormal(index, x, y, py, finiteDifferenceNormal(band, y - startz + 1, x + 1));
+#else
+				storeNormal(index, x, y, py, gradientNormal(dhdx[x], dhdz[x]));
+#endif
+				index += STRIDE;
 			}
-			px = worldx;
 			pz += SCALE;
-			tu = 0.0f;
-			tv += texIncrement();
 		}
 	}
-	inline float height(float* mesh, int x, int z, float wx, float wz) {				// return height of specified vertex - must compute out of bounds coordinates
-		if (x < 0 || x > DIM || z < 0 || z > DIM) return computeHeight(wx, wz);	
-		return vertex[3 * (z * VDIM + x) + 1];		// return y component of vertex
+	inline float vertexHeight(int x, int z) const {										// return height of specified vertex
+		return height[z * VDIM + x];
 	}
-	inline glm::vec3 computeNormal(float* mesh, int x, int z, float wx, float wz) {		// return height-approximated normal vector for provided vertex
+#ifdef FINITE_DIFFERENCE_NORMALS
+	static inline glm::vec3 finiteDifferenceNormal(const float band[][VDIM + 2], int row, int col) {	// return height-approximated normal vector for the vertex at band[row][col]
 		float l, r, d, u;																// uses "finite difference" method - https://stackoverflow.com/questions/13983189/opengl-how-to-calculate-normals-in-a-terrain-height-grid
-		l = height(mesh, x - 1, z, wx - SCALE, wz);										// optional more accurate method: https://stackoverflow.com/questions/45477806/general-method-for-calculating-smooth-vertex-normals-with-100-smoothness
-		r = height(mesh, x + 1, z, wx + SCALE, wz);
-		u = height(mesh, x, z - 1, wx, wz - SCALE);
-		d = height(mesh, x, z + 1, wx, wz + SCALE);
+		l = band[row][col - 1];															// optional more accurate method: https://stackoverflow.com/questions/45477806/general-method-for-calculating-smooth-vertex-normals-with-100-smoothness
+		r = band[row][col + 1];
+		u = band[row - 1][col];
+		d = band[row + 1][col];
 		return glm::normalize(glm::vec3(l - r, 2.0f, d - u));
 	}
+#endif
 
 	// instance data
-	float* vertex;					// vertex positions
-	float* mesh;					// vertex, normal, and texture data for terrain chunk to be uploaded to GPU
-	unsigned int vao, vbo;			// GL vertex array, buffer object ID's
+	float* height;					// vertex heights, row major - attached storage, lives as long as the chunk
+	float* mesh;					// normal data for terrain chunk to be uploaded to GPU - borrowed storage, only valid until detached
 	float worldx;					// corresponding world coordinate for the lower leftmost vertex of this chunk
 	float worldz;
+	float minHeight;				// vertical extent of this chunk's terrain - bounds the chunk for view frustum culling
+	float maxHeight;
 
-	// give cache class private access
-	friend class Cache;		
+	// give cache and terrain buffer classes private access
+	friend class Cache;
+	friend class TerrainBuffers;		
 
 public:
 
-	// dummy constructor - stupid hack
-	Chunk(bool isDummy) {
-		if (true) {
-			mesh = new float[meshElements()];
-			vertex = new float[vertexElements()];
-			vao = 0;
-			vbo = 0;
-		}
-		else {
-			printf("MUST INIT AS DUMMY OBJECT.\n");
-			exit(0);
-		}
-	}
+	// Constructor - chunks do not own their storage. height storage must be attached before generating
+	Chunk() : height(nullptr), mesh(nullptr), worldx(0.0f), worldz(0.0f), minHeight(0.0f), maxHeight(0.0f) {}
 
-	// Constructor
-	Chunk(int chunkcoordx = 0, int chunkcoordz = 0) {
-
-		// allocate
-		mesh = new float[meshElements()];
-		vertex = new float[vertexElements()];
-
-		// transform chunk coord to world coords - points to centre of chunk
-		worldx = (float)(int)(CHUNK_WIDTH * chunkcoordx);
-		worldz = (float)(int)(CHUNK_WIDTH * chunkcoordz);
-		worldx -= boundaryOffset();		// transform coords to point to lower leftmost vertex of chunk
-		worldz -= boundaryOffset();
-
-		// generate mesh position data in parallel - 3 threads - TODO: move to thread pool eventually to improve performance
-		static constexpr int NUMTHREADS = 3;
-		static constexpr int ZSPLIT1 = VDIM / NUMTHREADS;
-		static constexpr int ZSPLIT2 = ZSPLIT1 + ZSPLIT1;
-		std::thread t1(&Chunk::generateMeshData, this, 0, ZSPLIT1, worldx, worldz, 0);
-		std::thread t2(&Chunk::generateMeshData, this, ZSPLIT1, ZSPLIT2, worldx, worldz, (ZSPLIT1 * texIncrement()));
-		generateMeshData(ZSPLIT2, VDIM, worldx, worldz, (ZSPLIT2 * texIncrement()));
-		t1.join();
-		t2.join();
-		//t3.join();
-
-		// generate vertex normals for mesh
-		unsigned int index = 0;
-		float vx, vz;
-		glm::vec3 norm;
-		for (int y = 0; y < VDIM; y++) {
-			for (int x = 0; x < VDIM; x++) {
-				// store vertex normals
-				vx = mesh[index];
-				index += 2;										// skip y component
-				vz = mesh[index++];
-				norm = computeNormal(mesh, x, y, vx, vz);
-#ifdef DRAW_CHUNK_BORDERS
-				if (x == 0 || x == DIM || y == 0 || y == DIM) norm *= -1;		// invert normal to show chunk borders
-#endif
-				mesh[index++] = norm.x;
-				mesh[index++] = norm.y;
-				mesh[index++] = norm.z;
-				index += 2;										// skip texture coords
-			}
-		}
-	}
+	// delete copy - chunks are recycled in place rather than copied
+	Chunk(const Chunk& other) = delete;
+	Chunk& operator=(const Chunk& other) = delete;
 
-	// Destructor - cleanup
-	~Chunk() {
-		delete[] mesh;
-		delete[] vertex;
-		glDeleteVertexArrays(1, &vao);
-		glDeleteBuffers(1, &vbo);
+	// storage sizes in # floats - every vertex of a chunk, its height field, and its mesh data for GPU upload
+	static constexpr int numVertices() { return VDIM * VDIM; }
+	static constexpr int heightElements() { return numVertices(); }
+	static constexpr int meshElements() { return STRIDE * numVertices(); }
+
+	// attach storage for heightElements() floats - storage must outlive the chunk
+	void attach(float* heightStorage) {
+		height = heightStorage;
 	}
 
-	// copy and swap - https://stackoverflow.com/questions/3279543/what-is-the-copy-and-swap-idiom
-	friend void swap(Chunk& first, Chunk& second) {
-		using std::swap;
-		swap(first.vao, second.vao);
-		swap(first.vbo, second.vbo);
-		swap(first.vertex, second.vertex);
-		swap(first.mesh, second.mesh);
+	// returns the mesh storage passed to the last generate call - the chunk no longer refers to it
+	float* detachMesh() {
+		float* m = mesh;
+		mesh = nullptr;
+		return m;
 	}
 
-	// Copy constructor
-	Chunk(const Chunk& other) : vertex(new float[vertexElements()]), mesh(new float[meshElements()]), vao(other.vao), vbo(other.vbo) {
-		std::copy(other.vertex, other.vertex + vertexElements(), vertex);
-		std::copy(other.mesh, other.mesh + meshElements(), mesh);
+	// generate the terrain of the chunk at the given chunk coordinate in place, overwriting any previous terrain
+	// vertex heights are written to the attached height storage, remaining data for GPU upload to meshStorage (meshElements() floats)
+	// bands of rows are generated in parallel on the given pool
+	void generate(int chunkcoordx, int chunkcoordz, float* meshStorage, ThreadPool& pool = ThreadPool::shared()) {
+		PROFILE_ZONE("Chunk::generate");
+		mesh = meshStorage;
+
+		worldx = origin(chunkcoordx);
+		worldz = origin(chunkcoordz);
+
+		// generate mesh data in parallel - rows are split into bands across the thread pool
+		std::mutex boundsLock;
+		minHeight = std::numeric_limits<float>::max();
+		maxHeight = std::numeric_limits<float>::lowest();
+		pool.parallelFor(0, VDIM, [this, &boundsLock](int startz, int endz) {
+			PROFILE_ZONE("Chunk::generateMeshData");
+			float bandMin, bandMax;
+			generateMeshData(startz, endz, worldx, worldz, bandMin, bandMax);
+			std::lock_guard<std::mutex> lk(boundsLock);								// track the vertical extent of the terrain
+			minHeight = std::min(minHeight, bandMin);
+			maxHeight = std::max(maxHeight, bandMax);
+		});
 	}
 
-	// Copy assign
-	Chunk& operator=(Chunk other) {
-		swap(*this, other);
-		return *this;
+	// restore the terrain of the chunk at the given chunk coordinate from a previous generate - heights are copied into the
+	// attached height storage, minh and maxh are the chunk's vertical extent
+	void restore(int chunkcoordx, int chunkcoordz, const float* heights, float minh, float maxh) {
+		worldx = origin(chunkcoordx);
+		worldz = origin(chunkcoordz);
+		std::copy(heights, heights + heightElements(), height);
+		minHeight = minh;
+		maxHeight = maxh;
 	}
 
-	// Move constructor
-	Chunk(Chunk&& other) noexcept : vao(0), vbo(0), vertex(), mesh() {
-		swap(*this, other);
+	// attached height field - heightElements() floats, row major
+	const float* heightField() const {
+		return height;
 	}
 
-	// returns the y-value at the specified coordinate
-	float getHeight(float wx, float wz) {
+	// returns the height of the full detail mesh at the given world coordinate - interpolated over the triangle containing it
+	// coordinates outside of the chunk are clamped to its nearest edge
+	float getHeight(float wx, float wz) const {
 		// convert world coords to chunk mesh coords
 		float distx = (wx - worldx) / SCALE;	// dist from lower leftmost vertex in mesh (0,0)
 		float distz = (wz - worldz) / SCALE;
-		int index_x = (int)distx;
-		int index_z = (int)distz;
-		// use 4 nearest points to interpolate height of point
-		float h1 = height(mesh, index_x, index_z, wx, wz);
-		//float h2 = height(mesh, index_x+1, index_z, wx+SCALE, wz);
-		//float h3 = height(mesh, index_x, index_z+1, wx, wz+SCALE);
-		//float h4 = height(mesh, index_x+1, index_z+1, wx+SCALE, wz+SCALE);
-		return h1;
+		int index_x = std::min(std::max((int)floor(distx), 0), DIM - 1);	// containing cell
+		int index_z = std::min(std::max((int)floor(distz), 0), DIM - 1);
+		float fx = glm::clamp(distx - index_x, 0.0f, 1.0f);				// position within cell
+		float fz = glm::clamp(distz - index_z, 0.0f, 1.0f);
+		// cells are split along the anti-diagonal from (x+1, z) to (x, z+1) - see emitGrid
+		if (fx + fz <= 1.0f) {
+			float h0 = vertexHeight(index_x, index_z);
+			return h0 + fx * (vertexHeight(index_x + 1, index_z) - h0) + fz * (vertexHeight(index_x, index_z + 1) - h0);
+		}
+		float h3 = vertexHeight(index_x + 1, index_z + 1);
+		return h3 + (1.0f - fx) * (vertexHeight(index_x, index_z + 1) - h3) + (1.0f - fz) * (vertexHeight(index_x + 1, index_z) - h3);
+	}
+
+	// batched getHeight - out[i] = getHeight(wx[i], wz[i])
+	void getHeights(const float* wx, const float* wz, float* out, int count) const {
+		for (int i = 0; i < count; i++) out[i] = getHeight(wx[i], wz[i]);
+	}
+
+	// returns the coordinate of the chunk containing the given world space coordinate (along either horizontal axis)
+	static inline int chunkCoord(float w) {
+		return (int)floor((w + boundaryOffset()) / CHUNK_WIDTH);
+	}
+
+	// hash of every constant that determines the generated terrain and its vertex format - data generated under a
+	// different hash must be regenerated
+	static uint64_t terrainHash() {
+		float params[] = { (float)CHUNK_WIDTH, SCALE, (float)VDIM, TEX_SCALE, MAX_AMPLITUDE, FREQUENCY, (float)OCTAVES, (float)STRIDE, (float)MESH_FORMAT };
+		uint64_t h = 14695981039346656037ull;								// FNV-1a
+		auto mix = [&h](const void* data, size_t bytes) {
+			for (size_t i = 0; i < bytes; i++) h = (h ^ static_cast<const unsigned char*>(data)[i]) * 1099511628211ull;
+		};
+		mix(params, sizeof(params));
+		mix(OCTAVE_FREQUENCY, sizeof(OCTAVE_FREQUENCY));
+		mix(OCTAVE_WEIGHT, sizeof(OCTAVE_WEIGHT));
+		return h;
 	}
 
 	// returns width of one chunk in world space
@@ -290,16 +540,195 @@ public:
 		return CHUNK_WIDTH;
 	}
 
-	// draws this terrain chunk to the screen
+	// world space bounding box of this chunk's terrain
+	glm::vec3 boundsMin() const {
+		return glm::vec3(worldx, minHeight, worldz);
+	}
+	glm::vec3 boundsMax() const {
+		return glm::vec3(worldx + SCALE * DIM, maxHeight, worldz + SCALE * DIM);
+	}
+
+	// conservative world space bounding box of the chunk at the given chunk coords - valid before the chunk is generated
+	static glm::vec3 boundsMin(int chunkcoordx, int chunkcoordz) {
+		return glm::vec3(CHUNK_WIDTH * chunkcoordx - boundaryOffset(), minTerrainHeight(), CHUNK_WIDTH * chunkcoordz - boundaryOffset());
+	}
+	static glm::vec3 boundsMax(int chunkcoordx, int chunkcoordz) {
+		return glm::vec3(CHUNK_WIDTH * chunkcoordx + boundaryOffset(), maxTerrainHeight(), CHUNK_WIDTH * chunkcoordz + boundaryOffset());
+	}
+
+	// limits of computeHeight - simplex noise lies in [-1, 1], so the summed elevation lies in [-octaveWeightSum(), 2 + octaveWeightSum()]
+	static constexpr float minTerrainHeight() {
+		return -MAX_AMPLITUDE / 4;																			// shapeHeight is minimal at elevation 0
+	}
+	static constexpr float maxTerrainHeight() {
+		return MAX_AMPLITUDE * ((2.0f + octaveWeightSum()) / 1.5f) * ((2.0f + octaveWeightSum()) / 1.5f) - MAX_AMPLITUDE / 4;
+	}
+
+	// computes the terrain height at the specified XZ plane coordinate in world space
+	static inline float computeHeight(float x, float z) {
+		glm::vec2 coord(x, z);															// https://www.redblobgames.com/maps/terrain-from-noise/
+		coord *= FREQUENCY;
+		float elevation = Noise::simplex(coord.x, coord.y) + 1;							// apply common frequency scale to all octaves
+		for (int o = 1; o < OCTAVES; o++) elevation += OCTAVE_WEIGHT[o] * Noise::simplex(OCTAVE_FREQUENCY[o] * coord.x, OCTAVE_FREQUENCY[o] * coord.y);
+		return shapeHeight(elevation);
+		//return (float)(cos(0.7 * (double)x)); - test sinusoidal heightmap
+	}
+
+	// cheap approximation of computeHeight from its leading octaves only - for queries against terrain that is not loaded
+	static inline float estimateHeight(float x, float z) {
+		glm::vec2 coord(x, z);
+		coord *= FREQUENCY;
+		float elevation = Noise::simplex(coord.x, coord.y) + 1;
+		for (int o = 1; o < ESTIMATE_OCTAVES; o++) elevation += OCTAVE_WEIGHT[o] * Noise::simplex(OCTAVE_FREQUENCY[o] * coord.x, OCTAVE_FREQUENCY[o] * coord.y);
+		return shapeHeight(elevation);
+	}
+
+	// batched computeHeight - out[i] = computeHeight(x[i], z[i]). noise is evaluated with the SIMD kernels in noise.h
+	static void computeHeights(const float* x, const float* z, float* out, int count) {
+		heightBatch<false>(x, z, out, nullptr, nullptr, count);
+	}
+
+	// batched estimateHeight - out[i] = estimateHeight(x[i], z[i])
+	static void estimateHeights(const float* x, const float* z, float* out, int count) {
+		heightBatch<false>(x, z, out, nullptr, nullptr, count, ESTIMATE_OCTAVES);
+	}
+
+	// vertex normal from the analytic height gradient returned by computeHeights / computeHeightRow
+	static inline glm::vec3 gradientNormal(float dhdx, float dhdz) {
+		return glm::normalize(glm::vec3(-SCALE * dhdx, 1.0f, SCALE * dhdz));			// same scale and orientation as the finite difference normalize(l - r, 2, d - u) over neighbouring vertices
+	}
+
+	// batched computeHeight with the analytic height gradient - dhdx[i], dhdz[i] = partial derivatives of out[i] along x and z
+	static void computeHeights(const float* x, const float* z, float* out, float* dhdx, float* dhdz, int count) {
+		heightBatch<true>(x, z, out, dhdx, dhdz, count);
+	}
+
+	// batched computeHeight along a row of count samples starting at (x, z), spaced step apart along the x axis
+	static void computeHeightRow(float x, float z, float step, float* out, int count) {
+		heightRow<false>(x, z, step, out, nullptr, nullptr, count);
+	}
+
+	// batched computeHeight with gradient along a row of count samples starting at (x, z), spaced step apart along the x axis
+	static void computeHeightRow(float x, float z, float step, float* out, float* dhdx, float* dhdz, int count) {
+		heightRow<true>(x, z, step, out, dhdx, dhdz, count);
+	}
+
+	// returns the base vertex of the given slot in a chunk buffer created by createBuffers
+	static constexpr int baseVertex(int slot) {
+		return slot * numVertices();
+	}
+
+	// number of supported levels of detail - level 0 is full resolution, every further level halves the grid resolution
+	static constexpr int lodLevels() {
+		return LOD_LEVELS;
+	}
+
+	// returns the number of indices drawn per chunk at the given level of detail
+	static int indexCount(int lod = 0) {
+		return lod_count[lod];
+	}
+
+	// returns the byte offset of the given level of detail in the shared index buffer
+	static const void* indexOffset(int lod = 0) {
+		return (const void*)(lod_first[lod] * sizeof(Index));
+	}
+
+	// # vertex shader invocations drawing one chunk at the given level of detail costs, simulated with a FIFO post-transform
+	// vertex cache of the given size over the index array computeSharedResources uploads - for benchmarks, builds the index array
+	static int vertexShaderInvocations(int lod, int cacheSize = VERTEX_CACHE) {
+		std::vector<Index> indices = initIndexArray();
+		std::deque<Index> cache;
+		int invocations = 0;
+		for (int i = lod_first[lod]; i < lod_first[lod] + lod_count[lod]; i++) {
+			if (indices[i] == RESTART || std::find(cache.begin(), cache.end(), indices[i]) != cache.end()) continue;
+			invocations++;
+			cache.push_back(indices[i]);
+			if ((int)cache.size() > cacheSize) cache.pop_front();
+		}
+		return invocations;
+	}
+
+	// the triangles drawn at the given level of detail as vertex index triples (out[3t], out[3t + 1], out[3t + 2]), in the
+	// winding the rasterizer sees - strips are expanded and their degenerate triangles dropped. for tests, builds the index array
+	static std::vector<int> triangles(int lod) {
+		std::vector<Index> indices = initIndexArray();
+		std::vector<int> out;
+		int strip = 0;																	// position within the current strip
+		for (int i = lod_first[lod]; i < lod_first[lod] + lod_count[lod]; i++) {
+#ifdef CHUNK_TRIANGLE_LISTS
+			(void)strip;
+			out.push_back(indices[i]);
+#else
+			if (indices[i] == RESTART) {
+				strip = 0;
+				continue;
+			}
+			if (++strip < 3) continue;
+			int a = indices[i - 2], b = indices[i - 1], c = indices[i];
+			if (a == b || b == c || a == c) continue;
+			if (strip % 2 == 0) std::swap(a, b);										// every other triangle of a strip has its first two vertices swapped
+			out.push_back(a);
+			out.push_back(b);
+			out.push_back(c);
+#endif
+		}
+		return out;
+	}
+
+	// byte size of one index, and true if chunks are drawn as triangle strips with primitive restart (not triangle lists)
+	static constexpr int indexSize() { return (int)sizeof(Index); }
+	static constexpr bool triangleStrips() { return PRIMITIVE == GL_TRIANGLE_STRIP; }
+
+	// post-transform vertex cache size assumed by vertexShaderInvocations
+	static constexpr int vertexCacheSize() { return VERTEX_CACHE; }
+
+	// vertex shader matching the uploaded vertex format - both reconstruct XZ position and texture coords from the vertex id
+	static const char* vertexShaderPath() {
+#ifdef COMPACT_CHUNK_VERTICES
+		return "shaders/chunkshader_compact.vs";
+#else
+		return "shaders/chunkshader.vs";
+#endif
+	}
+
+	// upload the grid constants the vertex shader reconstructs positions from
+	static void setupShader(Shader& terrainShader) {
+		terrainShader.use();
+		terrainShader.setInt("chunkOrigins", ORIGIN_TEXTURE_UNIT);
+		terrainShader.setInt("vdim", VDIM);
+		terrainShader.setFloat("cellScale", SCALE);
+		terrainShader.setFloat("texIncrement", texIncrement());
+#ifdef COMPACT_CHUNK_VERTICES
+		terrainShader.setFloat("heightMin", minTerrainHeight());
+		terrainShader.setFloat("heightRange", maxTerrainHeight() - minTerrainHeight());
+#endif
+	}
+
+	// draws a batch of terrain chunks from a chunk buffer (see createBuffers) with a single draw call
+	// entry i draws counts[i] indices starting at byte offset offsets[i] of the shared index buffer, for the chunk at vertex baseVertices[i]
 	// ensure to setup terrain shader beforehand
-	void draw() {
+	static void draw(unsigned int vao, const GLsizei* counts, const void* const* offsets, const GLint* baseVertices, int drawcount) {
+		if (drawcount == 0) return;
 		glBindVertexArray(vao);
-		glDrawElements(GL_TRIANGLES, indexElements(), GL_UNSIGNED_INT, 0);
+#ifndef CHUNK_TRIANGLE_LISTS
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(RESTART);			// compared against the index before the base vertex is added
+#endif
+		glMultiDrawElementsBaseVertex(PRIMITIVE, counts, INDEX_TYPE, offsets, drawcount, baseVertices);
+#ifndef CHUNK_TRIANGLE_LISTS
+		glDisable(GL_PRIMITIVE_RESTART);
+#endif
 	}
 };
 
 // Initialize static values
-int* Chunk::chunk_index = nullptr;
+constexpr float Chunk::OCTAVE_FREQUENCY[];
+constexpr float Chunk::OCTAVE_WEIGHT[];
+constexpr GLenum Chunk::INDEX_TYPE;
+constexpr Chunk::Index Chunk::RESTART;
+constexpr GLenum Chunk::PRIMITIVE;
+int Chunk::lod_first[Chunk::LOD_LEVELS] = {};
+int Chunk::lod_count[Chunk::LOD_LEVELS] = {};
 unsigned int Chunk::ebo = 0;
 
 #endif
\ No newline at end of file
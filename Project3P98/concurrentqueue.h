@@ -0,0 +1,179 @@
+#ifndef CS3P98_CONCURRENT_QUEUE_H
+#define CS3P98_CONCURRENT_QUEUE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+	Concurrent Queue
+	Mutex protected multi producer / multi consumer FIFO queue. Consumers may block until an item arrives - every push
+	wakes a waiting consumer immediately, so there is no polling delay. Closing the queue releases all blocked threads.
+
+	Besides plain FIFO order, consumers may pull the best scoring items (waitPopBest). Scores are evaluated at pop time,
+	so priorities that depend on changing state (ie. the player position) are always current.
+
+	Items are stored in a fixed capacity ring buffer allocated up front - pushing and popping never allocates. A push
+	into a full queue first drops cancelled items if given a cancellation test, and otherwise blocks until a consumer
+	makes room. Owners that bound the number of live items by the capacity therefore never block.
+*/
+template <typename T>
+class ConcurrentQueue {
+private:
+
+	// instance data
+	mutable std::mutex lock;
+	std::condition_variable ready;		// signalled on push and close
+	std::condition_variable space;		// signalled when items are removed and on close
+	std::vector<T> ring;				// ring buffer of capacity items
+	size_t head;						// ring index of the front item
+	size_t count;						// # queued items
+	std::vector<std::pair<float, size_t>> ranked;	// scratch space for waitPopBest - (score, item position)
+	bool closed;
+
+	// helper functions
+	inline T& at(size_t i) {			// item at position i from the front
+		return ring[(head + i) % ring.size()];
+	}
+	template <typename Remove>
+	size_t removeIf(Remove remove) {	// drop every item for which remove(item, position) returns true, keeping the order of the rest - returns # dropped
+		size_t kept = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (remove(at(i), i)) continue;
+			if (kept != i) at(kept) = std::move(at(i));
+			kept++;
+		}
+		size_t dropped = count - kept;
+		count = kept;
+		if (dropped) space.notify_all();
+		return dropped;
+	}
+	bool insert(std::unique_lock<std::mutex>& lk, const T& item) {	// wait for room, then append - false if the queue was closed
+		space.wait(lk, [this] { return closed || count < ring.size(); });
+		if (closed) return false;
+		at(count++) = item;
+		return true;
+	}
+
+public:
+
+	// Constructor - the queue holds at most capacity items
+	explicit ConcurrentQueue(size_t capacity) : ring(std::max(capacity, (size_t)1)), head(0), count(0), closed(false) {
+		ranked.reserve(ring.size());
+	}
+
+	// delete copy and move
+	ConcurrentQueue(const ConcurrentQueue& other) = delete;
+	ConcurrentQueue& operator=(const ConcurrentQueue& other) = delete;
+
+	// append an item and wake one waiting consumer - blocks while the queue is full
+	// returns false without queueing the item once the queue has been closed
+	bool push(const T& item) {
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			if (!insert(lk, item)) return false;
+		}
+		ready.notify_one();
+		return true;
+	}
+
+	// push, dropping the items for which cancelled(item) returns true first if the queue is full
+	// cancelled may release resources held by the items it cancels - it is called at most once for a dropped item
+	template <typename Cancelled>
+	bool push(const T& item, Cancelled cancelled) {
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			if (count == ring.size()) removeIf([&cancelled](T& queued, size_t) { return cancelled(queued); });
+			if (!insert(lk, item)) return false;
+		}
+		ready.notify_one();
+		return true;
+	}
+
+	// pop the front item into out if one is available. never blocks
+	bool tryPop(T& out) {
+		std::lock_guard<std::mutex> lk(lock);
+		if (count == 0) return false;
+		out = std::move(at(0));
+		head = (head + 1) % ring.size();
+		count--;
+		space.notify_one();
+		return true;
+	}
+
+	// block until at least one item is available, then move up to max items into out
+	// returns false without popping anything once the queue has been closed
+	bool waitPop(std::vector<T>& out, size_t max) {
+		std::unique_lock<std::mutex> lk(lock);
+		ready.wait(lk, [this] { return closed || count > 0; });
+		if (closed) return false;
+		size_t n = std::min(max, count);
+		for (size_t i = 0; i < n; i++) out.push_back(std::move(at(i)));
+		head = (head + n) % ring.size();
+		count -= n;
+		if (n) space.notify_all();
+		return true;
+	}
+
+	// block until at least one item is available, then move up to max items with the lowest score(item) into out
+	// items for which cancelled(item) returns true are dropped from the queue without being returned
+	// returns false without popping anything once the queue has been closed
+	template <typename Score, typename Cancelled>
+	bool waitPopBest(std::vector<T>& out, size_t max, Score score, Cancelled cancelled) {
+		std::unique_lock<std::mutex> lk(lock);
+		for (;;) {
+			ready.wait(lk, [this] { return closed || count > 0; });
+			if (closed) return false;
+			removeIf([&cancelled](T& queued, size_t) { return cancelled(queued); });
+			if (count > 0) break;
+		}
+
+		// score every pending item once, then take the best - ties keep FIFO order
+		ranked.clear();
+		for (size_t i = 0; i < count; i++) ranked.emplace_back(score(at(i)), i);
+		size_t n = max < ranked.size() ? max : ranked.size();
+		std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end());
+		for (size_t i = 0; i < n; i++) out.push_back(at(ranked[i].second));
+
+		// drop the taken items in one pass - taken positions in ascending order
+		std::sort(ranked.begin(), ranked.begin() + n, [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.second < b.second; });
+		size_t next = 0;
+		removeIf([this, &next, n](T&, size_t i) {
+			if (next < n && ranked[next].second == i) {
+				next++;
+				return true;
+			}
+			return false;
+		});
+		return true;
+	}
+
+	// release every blocked thread - subsequent waitPop calls return false immediately, pushes are refused
+	void close() {
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			closed = true;
+		}
+		ready.notify_all();
+		space.notify_all();
+	}
+
+	// number of queued items
+	size_t size() const {
+		std::lock_guard<std::mutex> lk(lock);
+		return count;
+	}
+
+	// maximum number of queued items
+	size_t capacity() const {
+		return ring.size();
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+};
+
+#endif
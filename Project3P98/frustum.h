@@ -0,0 +1,55 @@
+#ifndef CS3P98_FRUSTUM_H
+#define CS3P98_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+/*
+	View Frustum
+	Six clipping planes extracted from a combined projection * view matrix (Gribb & Hartmann method -
+	https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf)
+	Used to reject axis aligned bounding boxes that lie entirely outside the camera's view.
+*/
+class Frustum {
+private:
+
+	glm::vec4 planes[6];		// [left, right, bottom, top, near, far] - xyz = inward facing normal, w = distance
+
+public:
+
+	// Constructor - the default frustum contains everything
+	Frustum() {
+		for (int i = 0; i < 6; i++) planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	Frustum(const glm::mat4& projectionView) {
+		update(projectionView);
+	}
+
+	// extract planes from a projection * view matrix
+	void update(const glm::mat4& m) {
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);	// glm matrices are column major
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+		planes[0] = row3 + row0;
+		planes[1] = row3 - row0;
+		planes[2] = row3 + row1;
+		planes[3] = row3 - row1;
+		planes[4] = row3 + row2;
+		planes[5] = row3 - row2;
+	}
+
+	// returns false if the axis aligned box [min, max] is entirely outside of the frustum
+	// conservative - boxes near frustum corners may be reported as intersecting
+	bool intersects(const glm::vec3& min, const glm::vec3& max) const {
+		for (int i = 0; i < 6; i++) {
+			const glm::vec4& p = planes[i];
+			glm::vec3 corner(p.x >= 0.0f ? max.x : min.x,		// box corner furthest along the plane normal
+							 p.y >= 0.0f ? max.y : min.y,
+							 p.z >= 0.0f ? max.z : min.z);
+			if (p.x * corner.x + p.y * corner.y + p.z * corner.z + p.w < 0.0f) return false;
+		}
+		return true;
+	}
+};
+
+#endif
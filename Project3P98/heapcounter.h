@@ -0,0 +1,66 @@
+#ifndef CS3P98_HEAP_COUNTER_H
+#define CS3P98_HEAP_COUNTER_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// uncomment to count heap allocations - replaces the global operator new, so at most one translation unit of a program
+// may include this header with it defined (ie. main.cpp in a debug build, or benchmark.cpp)
+//#define COUNT_HEAP_ALLOCATIONS
+
+/*
+	Heap Allocation Counter
+	Counts heap allocations made through operator new, both process wide and per thread. Reading the calling thread's
+	count before and after a section of work gives the allocations that section made, regardless of what other threads
+	allocate meanwhile (see Cache::allocations).
+
+	Counting is only compiled in when COUNT_HEAP_ALLOCATIONS is defined - otherwise every count stays 0.
+*/
+class HeapCounter {
+private:
+
+	// class data
+	static std::atomic<size_t> processCount;		// # allocations made by every thread
+	static thread_local size_t threadCount;			// # allocations made by the calling thread
+
+public:
+
+	// true if allocations are being counted
+	static constexpr bool enabled() {
+#ifdef COUNT_HEAP_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// # heap allocations made by the whole process
+	static size_t total() { return processCount.load(std::memory_order_relaxed); }
+
+	// # heap allocations made by the calling thread
+	static size_t thisThread() { return threadCount; }
+
+	// record one allocation on the calling thread - called by the counting operator new
+	static void count() {
+		processCount.fetch_add(1, std::memory_order_relaxed);
+		threadCount++;
+	}
+};
+
+// Initialize static values
+std::atomic<size_t> HeapCounter::processCount(0);
+thread_local size_t HeapCounter::threadCount = 0;
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+// counting replacements of the global allocation functions - array and nothrow forms forward to these
+void* operator new(size_t size) {
+	HeapCounter::count();
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif
+
+#endif
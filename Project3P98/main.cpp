@@ -20,6 +20,7 @@
 #include "world.h"
 #include "models.h"
 #include "shader.h"			// shader loading library - https://learnopengl.com/code_viewer_gh.php?code=includes/learnopengl/shader.h
+#include "profiler.h"		// frame profiler - F9 captures a Chrome trace
 #include "camera.h"		    // camera - MUST BE REPLACED W/ CUSTOM FLIGHTSIM CAM USING QUATERNIONS
 #include <glm/glm.hpp>		// GLM - https://glm.g-truc.net/0.9.9/index.html
 #include <glm/gtc/matrix_transform.hpp>
@@ -40,6 +41,7 @@ void start_keyboard(GLFWwindow* window);
 void end_keyboard(GLFWwindow* window);
 void pause_keyboard(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double x, double y);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void window_resize_callback(GLFWwindow* window, int w, int h);
 
 
@@ -66,7 +68,7 @@ bool pause = false;
 void initGLAD() {
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
 		printf("GLAD initialization failed.\n");
-		terminate();
+		terminateProgram();
 	}
 }
 
@@ -81,12 +83,13 @@ GLFWwindow* createWindow(unsigned int w, unsigned int h) {
 	GLFWwindow* window = glfwCreateWindow(w, h, "COSC 3P98 Project", nullptr, nullptr);		// create window
 	if (window == NULL) {
 		printf("GLFW window creation failed.\n");
-		terminate();
+		terminateProgram();
 	}
 	width = w; height = h;
 	glfwMakeContextCurrent(window);											// set focus																				
 	glfwSetFramebufferSizeCallback(window, window_resize_callback);			// bind resize callback
 	glfwSetCursorPosCallback(window, mouse_callback);						// bind mouse motion callback
+	glfwSetKeyCallback(window, key_callback);								// bind key press callback
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	return window;
 }
@@ -98,6 +101,7 @@ GLFWwindow* createWindow() {
 
 // main func
 int main(int argc, char* argv[]) {		
+	const int64_t launched = Profiler::now();	// startup timing - reported once the first frame is presented
 
 	// perform setup
 	glfwInit();									// init GLFW and set options
@@ -107,13 +111,17 @@ int main(int argc, char* argv[]) {
 
 	GLFWwindow* window = createWindow();		// Create OpenGL window
 	initGLAD();
+	Shader::loadExtensions((GLADloadproc)glfwGetProcAddress);	// program binary cache and parallel shader compilation
 	glfwSetWindowPos(window, 700, 100);
 
 	// enable gl options
 	glEnable(GL_DEPTH_TEST);		// enable depth testing
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+	const int64_t contextReady = Profiler::now();
 	World w(cam);
+	const int64_t worldReady = Profiler::now();
+	bool firstFrame = true;
 
 	// FPS calculation via simple moving average - https://stackoverflow.com/a/87732
 	constexpr int SAMPLES = 50;
@@ -123,11 +131,13 @@ int main(int argc, char* argv[]) {
 	for (int i = 0; i < SAMPLES; i++) fpsSamples[i] = 0;
 	float currentFrame;
 
-	printf("CONTROLS:\n1:WireFrame Terrain\n2:Solid Terrain\nLEFT SHIFT:Thrust Forward\nP:Pause \nU:Unpause\nW:Pitch Up\nS:Pitch Down\nA:Yaw Left\nD:Yaw Right\nQ:Roll Left\nE:Roll Right\n");
+	printf("CONTROLS:\n1:WireFrame Terrain\n2:Solid Terrain\nLEFT SHIFT:Thrust Forward\nP:Pause \nU:Unpause\nW:Pitch Up\nS:Pitch Down\nA:Yaw Left\nD:Yaw Right\nQ:Roll Left\nE:Roll Right\nF9:Start/Stop Profiler Capture\n");
 	printf("PRESS THE LEFT SHIFT KEY TO START!\n");
 
 	// render loop
+	Profiler::nameThread("main");
 	while (!glfwWindowShouldClose(window)) {	
+		PROFILE_ZONE("frame");
 		// time logic
 		currentFrame = (float)glfwGetTime();
 		deltatime = currentFrame - lastframe;
@@ -165,7 +175,16 @@ int main(int argc, char* argv[]) {
 		float curTerrain = w.testHeight(cam.camPos.x, cam.camPos.z);
 		float curDif = cam.camPos.y - curTerrain;
 
-		glfwSwapBuffers(window);				
+		{
+			PROFILE_ZONE("swap");
+			glfwSwapBuffers(window);
+		}
+		if (firstFrame) {
+			firstFrame = false;
+			printf("Time to first frame: %.1f ms (context %.1f ms, world setup %.1f ms - %d shader programs from cache, %d compiled%s)\n",
+				(Profiler::now() - launched) / 1e6, (contextReady - launched) / 1e6, (worldReady - contextReady) / 1e6,
+				Shader::cachedPrograms(), Shader::compiledPrograms(), Shader::parallelCompile() ? " in parallel" : "");
+		}
 		glfwPollEvents();
 
 		//Enforce the camera will never go above 30 as max height.
@@ -270,6 +289,20 @@ void pause_keyboard(GLFWwindow* window) {
 	}
 }
 
+// runs when a key is pressed - F9 starts a profiler capture, and pressing it again writes the capture to trace.json
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	if (key != GLFW_KEY_F9 || action != GLFW_PRESS) return;
+	if (!Profiler::capturing()) {
+		Profiler::begin();
+		printf("PROFILER CAPTURE STARTED! PRESS F9 TO STOP\n");
+	}
+	else {
+		long events = Profiler::end("trace.json");
+		if (events < 0) printf("FAILED TO WRITE trace.json\n");
+		else printf("PROFILER CAPTURE WRITTEN TO trace.json (%ld events) - open in chrome://tracing or ui.perfetto.dev\n", events);
+	}
+}
+
 // runs when the mouse is moved - manuipulates camera control
 void mouse_callback(GLFWwindow* window, double x, double y) {
 	//As long as the game isn't paused and it's still going, the player can navigate with their mouse.
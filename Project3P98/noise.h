@@ -0,0 +1,215 @@
+#ifndef CS3P98_NOISE_H
+#define CS3P98_NOISE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/noise.hpp>
+#include <cmath>
+
+// uncomment to force the scalar noise path even when SIMD instructions are available
+//#define NOISE_NO_SIMD
+
+#if !defined(NOISE_NO_SIMD) && defined(__AVX__)
+#include <immintrin.h>
+#define NOISE_AVX
+#elif !defined(NOISE_NO_SIMD) && defined(__SSE4_1__)
+#include <smmintrin.h>
+#define NOISE_SSE4
+#elif !defined(NOISE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define NOISE_SSE2
+#endif
+
+/*
+	Batched Simplex Noise
+
+	Evaluates 2D simplex noise for many sample points at once. The vector kernels are a lane-wise transcription of
+	glm::simplex(vec2) (Stefan Gustavson / Ashima Arts webgl-noise) that performs the same floating point operations
+	in the same order, so results match the scalar glm version to within rounding of fused multiply-adds.
+
+	The widest instruction set enabled at compile time is used - 8 lanes with AVX, 4 lanes with SSE4.1 or SSE2 (the x86-64
+	baseline, so every 64 bit build vectorizes - MSVC never defines __SSE4_1__, it only reaches AVX through /arch:AVX2),
+	otherwise every sample falls back to glm::simplex. There is no runtime dispatch - shipped builds stay on the SSE2
+	baseline so they run on any x86-64 CPU, wider paths are opt in (TERRAIN_NATIVE in the CMake build).
+
+	The gradient variants additionally return the analytic partial derivatives of the noise, computed alongside the
+	value by the same kernel (derivative of each corner's t^4 * (g . d) falloff term).
+*/
+class Noise {
+private:
+
+	// thin wrappers around scalar math and the intrinsics so that a single kernel serves every vector width
+	struct Scalar {
+		typedef float type;
+		static constexpr int lanes = 1;
+		static inline type load(const float* p) { return *p; }
+		static inline void store(float* p, type a) { *p = a; }
+		static inline type set(float a) { return a; }
+		static inline type add(type a, type b) { return a + b; }
+		static inline type sub(type a, type b) { return a - b; }
+		static inline type mul(type a, type b) { return a * b; }
+		static inline type div(type a, type b) { return a / b; }
+		static inline type max(type a, type b) { return a > b ? a : b; }
+		static inline type floor(type a) { return std::floor(a); }
+		static inline type abs(type a) { return std::fabs(a); }
+		static inline type gtmask(type a, type b, type v) { return a > b ? v : 0.0f; }							// a > b ? v : 0
+	};
+#ifdef NOISE_AVX
+	struct Vec {
+		typedef __m256 type;
+		static constexpr int lanes = 8;
+		static inline type load(const float* p) { return _mm256_loadu_ps(p); }
+		static inline void store(float* p, type a) { _mm256_storeu_ps(p, a); }
+		static inline type set(float a) { return _mm256_set1_ps(a); }
+		static inline type add(type a, type b) { return _mm256_add_ps(a, b); }
+		static inline type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+		static inline type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+		static inline type div(type a, type b) { return _mm256_div_ps(a, b); }
+		static inline type max(type a, type b) { return _mm256_max_ps(a, b); }
+		static inline type floor(type a) { return _mm256_floor_ps(a); }
+		static inline type abs(type a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static inline type gtmask(type a, type b, type v) { return _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ), v); }	// a > b ? v : 0
+	};
+#elif defined(NOISE_SSE4) || defined(NOISE_SSE2)
+	struct Vec {
+		typedef __m128 type;
+		static constexpr int lanes = 4;
+		static inline type load(const float* p) { return _mm_loadu_ps(p); }
+		static inline void store(float* p, type a) { _mm_storeu_ps(p, a); }
+		static inline type set(float a) { return _mm_set1_ps(a); }
+		static inline type add(type a, type b) { return _mm_add_ps(a, b); }
+		static inline type sub(type a, type b) { return _mm_sub_ps(a, b); }
+		static inline type mul(type a, type b) { return _mm_mul_ps(a, b); }
+		static inline type div(type a, type b) { return _mm_div_ps(a, b); }
+		static inline type max(type a, type b) { return _mm_max_ps(a, b); }
+#ifdef NOISE_SSE4
+		static inline type floor(type a) { return _mm_floor_ps(a); }
+#else
+		static inline type floor(type a) {				// SSE2 has no rounding instruction - truncate, then step down where truncation rounded up. exact for |a| < 2^31
+			type t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+			return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+		}
+#endif
+		static inline type abs(type a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static inline type gtmask(type a, type b, type v) { return _mm_and_ps(_mm_cmpgt_ps(a, b), v); }					// a > b ? v : 0
+	};
+#else
+	typedef Scalar Vec;
+#endif
+
+	// glm::detail::mod289 and permute
+	template <typename V>
+	static inline typename V::type mod289(typename V::type x) {
+		return V::sub(x, V::mul(V::floor(V::div(x, V::set(289.0f))), V::set(289.0f)));
+	}
+	template <typename V>
+	static inline typename V::type permute(typename V::type x) {
+		return mod289<V>(V::mul(V::add(V::mul(x, V::set(34.0f)), V::set(1.0f)), x));
+	}
+
+	// contribution of one simplex corner - x, y = offset from corner, p = permuted corner hash
+	// if Gradient, the partial derivatives of the contribution are added to dx, dy
+	template <typename V, bool Gradient>
+	static inline typename V::type corner(typename V::type x, typename V::type y, typename V::type p, typename V::type& dx, typename V::type& dy) {
+		typedef typename V::type vf;
+		vf t = V::max(V::sub(V::set(0.5f), V::add(V::mul(x, x), V::mul(y, y))), V::set(0.0f));
+		vf t2 = V::mul(t, t);
+		vf m = V::mul(t2, t2);
+		vf gx = V::sub(V::mul(V::set(2.0f), V::sub(V::mul(p, V::set(C3)), V::floor(V::mul(p, V::set(C3))))), V::set(1.0f));
+		vf h = V::sub(V::abs(gx), V::set(0.5f));
+		vf a0 = V::sub(gx, V::floor(V::add(gx, V::set(0.5f))));
+		vf norm = V::sub(V::set(1.79284291400159f), V::mul(V::set(0.85373472095314f), V::add(V::mul(a0, a0), V::mul(h, h))));
+		m = V::mul(m, norm);
+		vf g = V::add(V::mul(a0, x), V::mul(h, y));
+		if (Gradient) {																	// d/dx [t^4 n (g . d)] = t^4 n g - 8 t^3 n (g . d) x
+			vf s = V::mul(V::mul(V::set(-8.0f), V::mul(t2, t)), V::mul(norm, g));
+			dx = V::add(dx, V::add(V::mul(m, a0), V::mul(s, x)));
+			dy = V::add(dy, V::add(V::mul(m, h), V::mul(s, y)));
+		}
+		return V::mul(m, g);
+	}
+
+	// simplex noise for V::lanes sample points - if Gradient, also writes the partial derivatives to dx, dy
+	template <typename V, bool Gradient>
+	static inline typename V::type simplexKernel(typename V::type vx, typename V::type vy, typename V::type& dx, typename V::type& dy) {
+		typedef typename V::type vf;
+		const vf one = V::set(1.0f);
+
+		// first corner
+		vf d = V::add(V::mul(vx, V::set(C1)), V::mul(vy, V::set(C1)));
+		vf ix = V::floor(V::add(vx, d));
+		vf iy = V::floor(V::add(vy, d));
+		vf di = V::add(V::mul(ix, V::set(C0)), V::mul(iy, V::set(C0)));
+		vf x0 = V::add(V::sub(vx, ix), di);
+		vf y0 = V::add(V::sub(vy, iy), di);
+
+		// other corners
+		vf i1x = V::gtmask(x0, y0, one);
+		vf i1y = V::sub(one, i1x);
+		vf x1 = V::sub(V::add(x0, V::set(C0)), i1x);
+		vf y1 = V::sub(V::add(y0, V::set(C0)), i1y);
+		vf x2 = V::add(x0, V::set(C2));
+		vf y2 = V::add(y0, V::set(C2));
+
+		// permutations
+		const vf r = V::set(289.0f);
+		ix = V::sub(ix, V::mul(r, V::floor(V::div(ix, r))));
+		iy = V::sub(iy, V::mul(r, V::floor(V::div(iy, r))));
+		vf p0 = permute<V>(V::add(V::add(permute<V>(V::add(iy, V::set(0.0f))), ix), V::set(0.0f)));
+		vf p1 = permute<V>(V::add(V::add(permute<V>(V::add(iy, i1y)), ix), i1x));
+		vf p2 = permute<V>(V::add(V::add(permute<V>(V::add(iy, one)), ix), one));
+
+		// sum corner contributions
+		vf gx = V::set(0.0f), gy = V::set(0.0f);
+		vf n = V::add(V::add(corner<V, Gradient>(x0, y0, p0, gx, gy), corner<V, Gradient>(x1, y1, p1, gx, gy)), corner<V, Gradient>(x2, y2, p2, gx, gy));
+		if (Gradient) {
+			dx = V::mul(V::set(130.0f), gx);
+			dy = V::mul(V::set(130.0f), gy);
+		}
+		return V::mul(V::set(130.0f), n);
+	}
+
+	// glm::simplex constants
+	static constexpr float C0 = 0.211324865405187f;		// (3.0 -  sqrt(3.0)) / 6.0
+	static constexpr float C1 = 0.366025403784439f;		//  0.5 * (sqrt(3.0)  - 1.0)
+	static constexpr float C2 = -0.577350269189626f;	// -1.0 + 2.0 * C0
+	static constexpr float C3 = 0.024390243902439f;		//  1.0 / 41.0
+
+public:
+
+	// number of samples evaluated per vector kernel invocation
+	static constexpr int LANES = Vec::lanes;
+
+	// scalar simplex noise at (x, y)
+	static inline float simplex(float x, float y) {
+		return glm::simplex(glm::vec2(x, y));
+	}
+
+	// scalar simplex noise at (x, y) along with its partial derivatives dx = dn/dx, dy = dn/dy
+	static inline float simplex(float x, float y, float& dx, float& dy) {
+		return simplexKernel<Scalar, true>(x, y, dx, dy);
+	}
+
+	// batched simplex noise - out[i] = simplex(x[i], y[i]) for 0 <= i < count
+	static void simplex(const float* x, const float* y, float* out, int count) {
+		int i = 0;
+#if defined(NOISE_AVX) || defined(NOISE_SSE4) || defined(NOISE_SSE2)
+		Vec::type unused;
+		for (; i + LANES <= count; i += LANES) Vec::store(out + i, simplexKernel<Vec, false>(Vec::load(x + i), Vec::load(y + i), unused, unused));
+#endif
+		for (; i < count; i++) out[i] = simplex(x[i], y[i]);		// remainder
+	}
+
+	// batched simplex noise with partial derivatives - value and gradient come out of the same evaluation
+	static void simplex(const float* x, const float* y, float* out, float* dx, float* dy, int count) {
+		int i = 0;
+		Vec::type gx, gy;
+		for (; i + LANES <= count; i += LANES) {
+			Vec::store(out + i, simplexKernel<Vec, true>(Vec::load(x + i), Vec::load(y + i), gx, gy));
+			Vec::store(dx + i, gx);
+			Vec::store(dy + i, gy);
+		}
+		for (; i < count; i++) out[i] = simplex(x[i], y[i], dx[i], dy[i]);	// remainder
+	}
+};
+
+#endif
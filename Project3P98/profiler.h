@@ -0,0 +1,246 @@
+#ifndef CS3P98_PROFILER_H
+#define CS3P98_PROFILER_H
+
+#include <glad/glad.h>		// OpenGL function pointers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// uncomment to compile every profiler zone out of the build
+//#define DISABLE_PROFILER
+
+/*
+	Frame Profiler
+	Records named CPU zones (PROFILE_ZONE) on every thread, and GPU times (GpuTimer), while a capture is running.
+	Captures are written as Chrome trace event JSON - open them in chrome://tracing or https://ui.perfetto.dev
+
+	Each thread records into its own fixed size track, so recording never locks or allocates after a thread's first zone
+	of a capture. Zones opened while no capture is running cost a single atomic load.
+*/
+class Profiler {
+public:
+
+	// one recorded zone
+	struct Event {
+		const char* name;						// must outlive the capture - use string literals
+		int64_t start;							// ns since profiler epoch
+		int64_t duration;						// ns
+	};
+
+	// events recorded by one thread (or GPU timer)
+	struct Track {
+		std::string name;
+		int id;
+		std::unique_ptr<Event[]> events;
+		std::atomic<size_t> count;				// # events recorded in the current capture - published after each event is written
+		std::atomic<unsigned int> capture;		// capture the recorded events belong to
+		Track(const std::string& n, int i) : name(n), id(i), events(new Event[TRACK_EVENTS]), count(0), capture(0) {}
+	};
+
+	// RAII zone - records the time between construction and destruction on the calling thread's track
+	class Zone {
+	private:
+		const char* name;
+		int64_t start;
+	public:
+		explicit Zone(const char* zoneName) : name(zoneName), start(capturing() ? now() : -1) {}
+		~Zone() {
+			if (start >= 0) record(thisTrack(), name, start, now() - start);
+		}
+		Zone(const Zone& other) = delete;
+		Zone& operator=(const Zone& other) = delete;
+	};
+
+private:
+
+	// class constants
+	static constexpr size_t TRACK_EVENTS = 1 << 16;	// events per track per capture - later events are dropped
+
+	// class data
+	static std::mutex tracksLock;
+	static std::vector<std::unique_ptr<Track>> tracks;	// every track ever created - never shrinks, so track pointers stay valid
+	static std::atomic<bool> active;
+	static std::atomic<unsigned int> captureId;
+	static std::atomic<size_t> dropped;
+	static thread_local Track* threadTrack;
+
+public:
+
+	// ns since the profiler epoch (first call)
+	static int64_t now() {
+		static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	// true while a capture is running
+	static bool capturing() {
+		return active.load(std::memory_order_relaxed);
+	}
+
+	// create a track - unnamed tracks are named after their id. tracks are never destroyed
+	static Track* track(const std::string& name = "") {
+		std::lock_guard<std::mutex> lk(tracksLock);
+		int id = (int)tracks.size();
+		tracks.emplace_back(new Track(name.empty() ? "thread " + std::to_string(id) : name, id));
+		return tracks.back().get();
+	}
+
+	// the calling thread's track - created on first use
+	static Track* thisTrack() {
+		if (!threadTrack) threadTrack = track();
+		return threadTrack;
+	}
+
+	// name the calling thread's track in captures
+	static void nameThread(const std::string& name) {
+		Track* t = thisTrack();
+		std::lock_guard<std::mutex> lk(tracksLock);
+		t->name = name;
+	}
+
+	// record a zone on a track - only the owner of the track may record on it
+	static void record(Track* t, const char* name, int64_t start, int64_t duration) {
+		unsigned int id = captureId.load(std::memory_order_acquire);
+		if (t->capture.load(std::memory_order_relaxed) != id) {	// first event of this capture - drop events of earlier captures
+			t->count.store(0, std::memory_order_relaxed);
+			t->capture.store(id, std::memory_order_release);
+		}
+		size_t n = t->count.load(std::memory_order_relaxed);
+		if (n == TRACK_EVENTS) {
+			dropped++;
+			return;
+		}
+		t->events[n] = { name, start, duration };
+		t->count.store(n + 1, std::memory_order_release);
+	}
+
+	// start a new capture, discarding any previous one
+	static void begin() {
+		dropped = 0;
+		captureId++;
+		active = true;
+	}
+
+	// stop the current capture and write it to a Chrome trace JSON file. returns the # events written, or -1 on failure
+	static long end(const char* path) {
+		active = false;
+		unsigned int id = captureId.load();
+		FILE* f = fopen(path, "w");
+		if (!f) return -1;
+		long written = 0;
+		fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		std::lock_guard<std::mutex> lk(tracksLock);
+		for (const std::unique_ptr<Track>& t : tracks) {
+			fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", written++ ? ",\n" : "", t->id, t->name.c_str());
+			if (t->capture.load(std::memory_order_acquire) != id) continue;
+			size_t n = t->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < n; i++) {
+				const Event& e = t->events[i];
+				fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", e.name, t->id, e.start / 1000.0, e.duration / 1000.0);
+				written++;
+			}
+		}
+		fprintf(f, "\n]}\n");
+		fclose(f);
+		if (dropped > 0) printf("Profiler: %zu events dropped - tracks were full\n", dropped.load());
+		return written;
+	}
+};
+
+/*
+	GPU Timer
+	Times GPU work between begin and end with GL_TIME_ELAPSED queries. Results arrive a few frames late - collect polls
+	finished queries without stalling and records them on a "GPU" track, placed at the CPU time the work was submitted.
+	Queries may not be nested. Construct and use only on the thread associated with the opengl context.
+*/
+class GpuTimer {
+private:
+
+	// class constants
+	static constexpr int QUERIES = 16;			// queries in flight - zones are dropped while all are pending
+
+	struct Query {
+		GLuint id = 0;
+		const char* name = nullptr;
+		int64_t submitted = 0;					// CPU time at begin
+		bool pending = false;
+	};
+
+	// instance data
+	Query queries[QUERIES];
+	int next;									// next query to issue
+	int open;									// query between begin and end, -1 if none
+	Profiler::Track* gpu;
+
+public:
+
+	// Constructor - call after the opengl context has been created
+	GpuTimer() : next(0), open(-1), gpu(Profiler::track("GPU")) {
+		for (Query& q : queries) glGenQueries(1, &q.id);
+	}
+	~GpuTimer() {
+		for (Query& q : queries) glDeleteQueries(1, &q.id);
+	}
+
+	// delete copy
+	GpuTimer(const GpuTimer& other) = delete;
+	GpuTimer& operator=(const GpuTimer& other) = delete;
+
+	// start timing GPU commands issued from now on
+	void begin(const char* name) {
+		Query& q = queries[next];
+		if (!Profiler::capturing() || q.pending) return;
+		q.name = name;
+		q.submitted = Profiler::now();
+		q.pending = true;
+		glBeginQuery(GL_TIME_ELAPSED, q.id);
+		open = next;
+		next = (next + 1) % QUERIES;
+	}
+
+	// stop timing - matches the last begin
+	void end() {
+		if (open < 0) return;
+		glEndQuery(GL_TIME_ELAPSED);
+		open = -1;
+	}
+
+	// record every finished query - call once per frame
+	void collect() {
+		for (int i = 0; i < QUERIES; i++) {
+			Query& q = queries[i];
+			if (!q.pending || i == open) continue;
+			GLint available = 0;
+			glGetQueryObjectiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) continue;
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(q.id, GL_QUERY_RESULT, &elapsed);
+			Profiler::record(gpu, q.name, q.submitted, (int64_t)elapsed);
+			q.pending = false;
+		}
+	}
+};
+
+// Initialize static values
+std::mutex Profiler::tracksLock;
+std::vector<std::unique_ptr<Profiler::Track>> Profiler::tracks;
+std::atomic<bool> Profiler::active(false);
+std::atomic<unsigned int> Profiler::captureId(0);
+std::atomic<size_t> Profiler::dropped(0);
+thread_local Profiler::Track* Profiler::threadTrack = nullptr;
+
+// time the enclosing scope as a zone named name (a string literal)
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifdef DISABLE_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#endif
@@ -3,22 +3,76 @@
 
 #include <glm/glm.hpp>
 #include <glad/glad.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <initializer_list>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <unordered_map>
 #include <utility>          // std::pair
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 
 /*
 	Shader class
 	Represents a compiled shader program
 	Slightly modified version of https://learnopengl.com/code_viewer_gh.php?code=includes/learnopengl/shader.h written by Joey De Vries
+
+	Constructing a program only starts compiling and linking it - finish waits for the result and checks it for errors
+	(use finishes the program if necessary). Construct every program before finishing any of them so the driver can
+	compile them concurrently, on its own threads where GL_KHR_parallel_shader_compile is available.
+
+	Once loadExtensions has been called, linked programs are saved with glGetProgramBinary to a cache directory, keyed by
+	their sources and the driver, and later runs load the binary instead of compiling. A binary the driver rejects (ie.
+	after a driver update it was not keyed on) falls back to compiling from source.
 */
 class Shader {
 private:
 
+    // entry points and enums beyond the GL 3.3 core profile glad was generated for - loaded by loadExtensions
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+    typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+    static constexpr GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+    static constexpr GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+    static constexpr GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+    // program binary cache file header - followed by length bytes of program binary
+    struct BinaryHeader {
+        char magic[4];                // "3PSB"
+        uint32_t key;                 // low bits of the cache key - guards against renamed files
+        uint32_t format;              // binary format reported by the driver
+        uint32_t length;              // # bytes of program binary
+    };
+
+    // class data
+    static GetProgramBinaryProc getProgramBinary;      // nullptr unless program binaries are supported
+    static ProgramBinaryProc programBinary;
+    static ProgramParameteriProc programParameteri;
+    static bool parallel;                               // true if the driver compiles on its own threads
+    static uint64_t driverKey;                          // hash of the driver strings - part of every cache key
+    static std::string cacheDirectory;                  // program binary directory, with trailing separator
+    static int cached;                                  // # programs loaded from the cache
+    static int compiled;                                // # programs compiled from source
+
+    // instance data
+    std::string shaderName;           // source paths, for error messages
+    uint64_t key;                     // program binary cache key
+    unsigned int vertex, fragment, geometry;            // shaders being compiled - 0 once finished or if loaded from the cache
+    bool linked;                      // true once finished
+    std::unordered_map<std::string, GLint> locations;  // active uniform name -> location, filled once after linking
+
     // check compilation status of shader for errors
     static void checkShaderCompileStatus(unsigned int shader, const std::string& type, const std::string& name) {
         int status;
@@ -45,14 +99,125 @@ private:
         }
     }
 
+    // FNV-1a hash of a string, continuing from h
+    static uint64_t hash(uint64_t h, const char* s, size_t length) {
+        for (size_t i = 0; i < length; i++) h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+        return h;
+    }
+    static uint64_t hash(uint64_t h, const std::string& s) {
+        return hash(h, s.c_str(), s.size() + 1);        // include the terminator so ("ab", "c") and ("a", "bc") differ
+    }
+
+    // path of the cache file holding this program's binary
+    std::string binaryPath(const char* suffix = "") const {
+        char file[32];
+        snprintf(file, sizeof(file), "%016llx.bin", (unsigned long long)key);
+        return cacheDirectory + file + suffix;
+    }
+
+    // link the program from its cached binary - returns false if there is none or the driver rejects it
+    bool loadBinary() {
+        if (!programBinary) return false;
+        std::ifstream in(binaryPath(), std::ios::binary);
+        BinaryHeader h;
+        if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) || memcmp(h.magic, "3PSB", 4) != 0 || h.key != (uint32_t)key) return false;
+        std::vector<char> binary(h.length);
+        if (!in.read(binary.data(), h.length)) return false;
+        programBinary(ID, (GLenum)h.format, binary.data(), (GLsizei)h.length);
+        GLint status = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &status);
+        return status != 0;
+    }
+
+    // save the linked program's binary to the cache - written to a temporary file first so a reader never sees part of one
+    void storeBinary() const {
+        if (!getProgramBinary) return;
+        GLint length = 0;
+        glGetProgramiv(ID, PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        getProgramBinary(ID, length, &length, &format, binary.data());
+        BinaryHeader h;
+        memcpy(h.magic, "3PSB", 4);
+        h.key = (uint32_t)key;
+        h.format = format;
+        h.length = (uint32_t)length;
+        std::string file = binaryPath(), temp = binaryPath(".tmp");
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        bool ok = (bool)out.write(reinterpret_cast<const char*>(&h), sizeof(h)) && (bool)out.write(binary.data(), length);
+        out.close();
+        if (ok) {
+            std::remove(file.c_str());                  // rename does not replace existing files on every platform
+            ok = std::rename(temp.c_str(), file.c_str()) == 0;
+        }
+        if (!ok) std::remove(temp.c_str());
+    }
+
+    // compile one shader stage without waiting for the result
+    static unsigned int compile(GLenum type, const std::string& code) {
+        unsigned int shader = glCreateShader(type);
+        const char* source = code.c_str();
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
 public:
 
     // glob vars
     const unsigned int ID;            // shader program ID
 
-    // constructor
+    // load the program binary and parallel compile extensions if the driver supports them - call once after GLAD is initialized,
+    // before constructing any program. load resolves GL function names (ie. glfwGetProcAddress)
+    static void loadExtensions(GLADloadproc load, const std::string& directory = "shadercache")
+    {
+        bool binaries = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1), parallelCompile = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, (GLuint)i));
+            if (!strcmp(ext, "GL_ARB_get_program_binary")) binaries = true;
+            else if (!strcmp(ext, "GL_KHR_parallel_shader_compile")) parallelCompile = true;
+        }
+        GLint formats = 0;
+        if (binaries) glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &formats);
+#ifdef _WIN32
+        bool directoryReady = _mkdir(directory.c_str()) == 0 || errno == EEXIST;
+#else
+        bool directoryReady = mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+        if (formats > 0 && directoryReady) {
+            getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+            programBinary = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+            programParameteri = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+            if (!getProgramBinary || !programBinary || !programParameteri) {
+                getProgramBinary = nullptr;
+                programBinary = nullptr;
+                programParameteri = nullptr;
+            }
+        }
+        MaxShaderCompilerThreadsProc maxThreads = parallelCompile ? reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR")) : nullptr;
+        if (maxThreads) maxThreads(0xFFFFFFFFu);        // let the driver pick how many threads to compile on
+        parallel = maxThreads != nullptr;
+        driverKey = 14695981039346656037ull;
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION }) {
+            const char* s = reinterpret_cast<const char*>(glGetString(name));
+            if (s) driverKey = hash(driverKey, s, strlen(s) + 1);
+        }
+        cacheDirectory = directory + "/";
+    }
+
+    // # programs loaded from the program binary cache and compiled from source so far
+    static int cachedPrograms() { return cached; }
+    static int compiledPrograms() { return compiled; }
+
+    // true if programs are compiled on driver threads (GL_KHR_parallel_shader_compile)
+    static bool parallelCompile() { return parallel; }
+
+    // constructor - starts compiling and linking the program, call finish (or use) to wait for it
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) :
-        ID(glCreateProgram())
+        key(0), vertex(0), fragment(0), geometry(0), linked(false), ID(glCreateProgram())
     {
 
         // retrieve the vertex/fragment source code from filePath
@@ -63,7 +228,7 @@ public:
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
 
-        std::string shaderName = std::string(vertexPath) + " | " + std::string(fragmentPath);
+        shaderName = std::string(vertexPath) + " | " + std::string(fragmentPath);
         if (geometryPath != nullptr) shaderName = shaderName + " | " + std::string(geometryPath);
 
         // ensure ifstream objects can throw exceptions:
@@ -99,105 +264,216 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-
-        // compile shaders
-        unsigned int vertex, fragment;
 
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkShaderCompileStatus(vertex, "Vertex", shaderName);
-
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkShaderCompileStatus(fragment, "Fragment", shaderName);
-
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (geometryPath != nullptr)
-        {
-            const char* gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkShaderCompileStatus(geometry, "Geometry", shaderName);
+        // programs are cached by their sources and the driver that compiled them
+        key = hash(hash(hash(driverKey, vertexCode), fragmentCode), geometryCode);
+        if (loadBinary()) {
+            cached++;
+            return;
         }
 
+        // compile shaders - errors are checked by finish, so programs constructed back to back compile concurrently
+        vertex = compile(GL_VERTEX_SHADER, vertexCode);
+        fragment = compile(GL_FRAGMENT_SHADER, fragmentCode);
+        if (geometryPath != nullptr) geometry = compile(GL_GEOMETRY_SHADER, geometryCode);
+
         // link shader prog
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
-            glAttachShader(ID, geometry);
+        if (geometry) glAttachShader(ID, geometry);
+        if (programParameteri) programParameteri(ID, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
-        checkShaderLinkStatus(ID, shaderName);
-
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if (geometryPath != nullptr) glDeleteShader(geometry);
+        compiled++;
     }
 
     ~Shader() {			// destructor - perform cleanup
+        if (vertex) glDeleteShader(vertex);
+        if (fragment) glDeleteShader(fragment);
+        if (geometry) glDeleteShader(geometry);
         glDeleteProgram(ID);
     }
 
-    // activate the shader
+    // delete copy
+    Shader(const Shader& other) = delete;
+    Shader& operator=(const Shader& other) = delete;
+
+    // wait for the program to compile and link, check it for errors, cache its binary and resolve its uniforms
+    void finish()
+    {
+        if (linked) return;
+        if (vertex) {
+            checkShaderCompileStatus(vertex, "Vertex", shaderName);
+            checkShaderCompileStatus(fragment, "Fragment", shaderName);
+            if (geometry) checkShaderCompileStatus(geometry, "Geometry", shaderName);
+            checkShaderLinkStatus(ID, shaderName);
+
+            // delete the shaders as they're linked into our program now and no longer necessery
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            if (geometry) glDeleteShader(geometry);
+            vertex = fragment = geometry = 0;
+            storeBinary();
+        }
+
+        // resolve the location of every active uniform once, so setters never query the driver by name
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> nameBuffer(maxLength + 1);
+        for (GLint i = 0; i < count; i++) {
+            GLint size;
+            GLenum type;
+            GLsizei length = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0) continue;     // uniform block member - set through a UniformBuffer
+            locations[name] = location;
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                locations[name.substr(0, name.size() - 3)] = location;      // arrays are reported as name[0] - accept the bare name too
+        }
+        linked = true;
+    }
+
+    // activate the shader - finishes it first if necessary
     void use()
     {
+        if (!linked) finish();
         glUseProgram(ID);
     }
 
-    // utility uniform functions
-    void setBool(const std::string& name, bool value) const
+    // location of a uniform resolved at link time, -1 if the program has no such active uniform (setting -1 is a no-op)
+    // resolve locations once and keep them to set uniforms in hot paths without any name lookup
+    GLint uniform(const std::string& name) const
+    {
+        std::unordered_map<std::string, GLint>::const_iterator it = locations.find(name);
+        return it == locations.end() ? -1 : it->second;
+    }
+
+    // bind a uniform block of this program to a uniform buffer binding point - returns false if the program does not use the block
+    bool bindBlock(const char* name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index == GL_INVALID_INDEX) return false;
+        glUniformBlockBinding(ID, index, binding);
+        return true;
+    }
+
+    // utility uniform functions - by resolved location
+    void setBool(GLint location, bool value) const
+    {
+        glUniform1i(location, (int)value);
+    }
+    void setInt(GLint location, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(location, value);
     }
-    void setInt(const std::string& name, int value) const
+    void setFloat(GLint location, float value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(location, value);
     }
-    void setFloat(const std::string& name, float value) const
+    void setVec2(GLint location, const glm::vec2& value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform2fv(location, 1, &value[0]);
     }
-    void setVec2(const std::string& name, const glm::vec2& value) const
+    void setVec2(GLint location, float x, float y) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2f(location, x, y);
     }
-    void setVec2(const std::string& name, float x, float y) const
+    void setVec3(GLint location, const glm::vec3& value) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform3fv(location, 1, &value[0]);
     }
-    void setVec3(const std::string& name, const glm::vec3& value) const
+    void setVec3(GLint location, float x, float y, float z) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3f(location, x, y, z);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const
+    void setVec4(GLint location, const glm::vec4& value) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform4fv(location, 1, &value[0]);
     }
-    void setVec4(const std::string& name, const glm::vec4& value) const
+    void setVec4(GLint location, float x, float y, float z, float w) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4f(location, x, y, z, w);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w)
+    void setMat2(GLint location, const glm::mat2& mat) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat2(const std::string& name, const glm::mat2& mat) const
+    void setMat3(GLint location, const glm::mat3& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat3(const std::string& name, const glm::mat3& mat) const
+    void setMat4(GLint location, const glm::mat4& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat4(const std::string& name, const glm::mat4& mat) const
+
+    // utility uniform functions - by name, looked up in the link time table
+    void setBool(const std::string& name, bool value) const { setBool(uniform(name), value); }
+    void setInt(const std::string& name, int value) const { setInt(uniform(name), value); }
+    void setFloat(const std::string& name, float value) const { setFloat(uniform(name), value); }
+    void setVec2(const std::string& name, const glm::vec2& value) const { setVec2(uniform(name), value); }
+    void setVec2(const std::string& name, float x, float y) const { setVec2(uniform(name), x, y); }
+    void setVec3(const std::string& name, const glm::vec3& value) const { setVec3(uniform(name), value); }
+    void setVec3(const std::string& name, float x, float y, float z) const { setVec3(uniform(name), x, y, z); }
+    void setVec4(const std::string& name, const glm::vec4& value) const { setVec4(uniform(name), value); }
+    void setVec4(const std::string& name, float x, float y, float z, float w) const { setVec4(uniform(name), x, y, z, w); }
+    void setMat2(const std::string& name, const glm::mat2& mat) const { setMat2(uniform(name), mat); }
+    void setMat3(const std::string& name, const glm::mat3& mat) const { setMat3(uniform(name), mat); }
+    void setMat4(const std::string& name, const glm::mat4& mat) const { setMat4(uniform(name), mat); }
+};
+
+// Initialize static values
+Shader::GetProgramBinaryProc Shader::getProgramBinary = nullptr;
+Shader::ProgramBinaryProc Shader::programBinary = nullptr;
+Shader::ProgramParameteriProc Shader::programParameteri = nullptr;
+bool Shader::parallel = false;
+uint64_t Shader::driverKey = 0;
+std::string Shader::cacheDirectory;
+int Shader::cached = 0;
+int Shader::compiled = 0;
+
+/*
+    Uniform Buffer class
+    A uniform buffer object bound to a fixed binding point, holding one T. Every program whose block is bound to the same
+    point (Shader::bindBlock) reads the same data, so shared state is uploaded once per change instead of once per program.
+    T must match the block's std140 layout - vec3 members take 16 bytes, so declare them as vec4 on the C++ side.
+*/
+template <typename T>
+class UniformBuffer {
+private:
+    GLuint ID;
+
+public:
+    const GLuint binding;             // uniform buffer binding point
+    T data;                           // CPU copy of the block - modify, then upload
+
+    // constructor - call after the opengl context has been created
+    explicit UniformBuffer(GLuint bindingPoint) :
+        ID(0), binding(bindingPoint), data()
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    ~UniformBuffer() {
+        glDeleteBuffers(1, &ID);
+    }
+
+    // delete copy
+    UniformBuffer(const UniformBuffer& other) = delete;
+    UniformBuffer& operator=(const UniformBuffer& other) = delete;
+
+    // upload data to the buffer with a single call
+    void upload() const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
     }
 };
 
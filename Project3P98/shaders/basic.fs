@@ -13,10 +13,14 @@ struct DLight {
 	vec3 specular;		// specular color
 };
 
-uniform vec3 viewpos;
+layout (std140) uniform FrameData {		// per frame state shared by every program - declared identically in every shader (World::FrameData)
+	mat4 projectionViewMatrix;
+	vec3 viewpos;
+	DLight dlight;						// directional light (ie. the sun)
+};
+
 uniform vec3 objcolor;
 uniform float spec_intensity;
-uniform DLight dlight;	// directional light (ie. the sun)
 
 void main() {
 	vec3 norm = normalize(normal);
@@ -8,13 +8,16 @@ in vec3 normal;
 
 struct DLight {
 	vec3 direction;		// directional light direction vector. keep w component 0.0f if vec4
-	vec3 diffuse;
-	vec3 ambient;
-	vec3 specular;
+	vec3 diffuse;		// diffuse color
+	vec3 ambient;		// ambient color
+	vec3 specular;		// specular color
 };
 
-uniform vec3 viewpos;
-uniform DLight dlight;	// directional light (ie. the sun)
+layout (std140) uniform FrameData {		// per frame state shared by every program - declared identically in every shader (World::FrameData)
+	mat4 projectionViewMatrix;
+	vec3 viewpos;
+	DLight dlight;						// directional light (ie. the sun)
+};
 
 void main() {
 	// compute fragment normal 
@@ -1,19 +1,40 @@
-
 #version 330 core
 
-layout (location = 0) in vec3 pos;
+layout (location = 0) in float height;		// world space height
 layout (location = 1) in vec3 norm;
-layout (location = 2) in vec2 tex;
 
 out vec3 fragpos;
 out vec3 normal;
 out vec2 texcoord;
 
-uniform mat4 projectionViewMatrix;
+struct DLight {
+	vec3 direction;		// directional light direction vector. keep w component 0.0f if vec4
+	vec3 diffuse;		// diffuse color
+	vec3 ambient;		// ambient color
+	vec3 specular;		// specular color
+};
+
+layout (std140) uniform FrameData {		// per frame state shared by every program - declared identically in every shader (World::FrameData)
+	mat4 projectionViewMatrix;
+	vec3 viewpos;
+	DLight dlight;						// directional light (ie. the sun)
+};
+
+uniform samplerBuffer chunkOrigins;			// world space XZ origin of the chunk in each vertex buffer slot
+uniform int vdim;							// # vertices along one side of a chunk
+uniform float cellScale;					// width of one cell in world space
+uniform float texIncrement;					// texture coordinate increment per cell
 
 void main() {
+	// gl_VertexID includes the base vertex of the chunk's slot - recover the slot and the grid coordinate within it
+	int slot = gl_VertexID / (vdim * vdim);
+	int local = gl_VertexID - slot * vdim * vdim;
+	vec2 grid = vec2(local % vdim, local / vdim);
+	vec2 origin = texelFetch(chunkOrigins, slot).xy;
+
+	vec3 pos = vec3(origin.x + grid.x * cellScale, height, origin.y + grid.y * cellScale);
 	fragpos = pos;
 	normal = norm;
-	texcoord = tex;
+	texcoord = grid * texIncrement;
 	gl_Position = projectionViewMatrix * vec4(pos, 1.0);
 }
\ No newline at end of file
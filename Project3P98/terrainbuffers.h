@@ -0,0 +1,61 @@
+#ifndef CS3P98_TERRAIN_BUFFERS_H
+#define CS3P98_TERRAIN_BUFFERS_H
+
+#include "chunk.h"
+#include <glad/glad.h>		// OpenGL function pointers
+
+/*
+	Terrain Buffers
+	GPU storage for the terrain of a fixed number of chunk slots - one vertex buffer holding the mesh of every slot back
+	to back, a texture buffer of slot origins, and the index buffer shared by every chunk.
+
+	Owned by the world and lent to the chunk cache, which uploads and draws through it. Keeping every GL resource here
+	lets the cache run without a GL context (ie. in tests). Construct, use and destroy only on the thread associated with
+	the opengl context.
+*/
+class TerrainBuffers {
+private:
+
+	// instance data
+	const int slots;									// # chunk slots
+	unsigned int vao, vbo;								// terrain vertex buffer holding the mesh of every slot back to back
+	unsigned int originBuffer, originTexture;			// texture buffer holding the world space origin of every slot
+
+public:
+
+	// Constructor - allocates storage for the given # chunk slots and the shared chunk index buffer
+	explicit TerrainBuffers(int slotCount) : slots(slotCount) {
+		Chunk::computeSharedResources();
+		Chunk::createBuffers(vao, vbo, slots);
+		Chunk::createOrigins(originBuffer, originTexture, slots);
+	}
+
+	~TerrainBuffers() {
+		Chunk::deleteBuffers(vao, vbo);
+		Chunk::deleteOrigins(originBuffer, originTexture);
+		Chunk::freeSharedResources();
+	}
+
+	// delete copy
+	TerrainBuffers(const TerrainBuffers& other) = delete;
+	TerrainBuffers& operator=(const TerrainBuffers& other) = delete;
+
+	// # chunk slots
+	int capacity() const { return slots; }
+
+	// upload a generated chunk into a slot - mesh is the mesh data written by Chunk::generate (or read back from a tile)
+	void upload(Chunk& chunk, int slot, const float* mesh) {
+		chunk.glLoad(vbo, slots, slot, mesh);
+		chunk.glLoadOrigin(originBuffer, slot);			// vertices are positioned relative to the slot's origin
+	}
+
+	// draws a batch of chunks with a single multi draw call - see Chunk::draw. the terrain shader must be setup beforehand
+	void draw(const GLsizei* counts, const void* const* offsets, const GLint* baseVertices, int drawcount) {
+		glActiveTexture(GL_TEXTURE0 + Chunk::ORIGIN_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_BUFFER, originTexture);
+		glActiveTexture(GL_TEXTURE0);
+		Chunk::draw(vao, counts, offsets, baseVertices, drawcount);
+	}
+};
+
+#endif
@@ -0,0 +1,440 @@
+/*
+	Terrain Tests - Checks the terrain core without a window or GL context
+
+	Covers the thread pool and the prioritized load queue, view frustum culling, the SIMD noise kernels against
+	glm::simplex, the chunk index buffer at every level of detail, interpolation of Chunk::getHeight over the chunk mesh,
+	the tile cache, and the chunk cache's domain shifts, slot mapping and cancelled (stale) loads through a cache
+	constructed without GPU storage.
+
+	The index buffer checks cover the topology selected at compile time - the terrain_tests_lists target builds the suite
+	again with CHUNK_TRIANGLE_LISTS.
+
+	Build with the terrain_tests CMake target (run by ctest), or by hand (from this directory):
+		g++ -std=c++14 -O2 -pthread -I"../GL Dependencies/include" tests.cpp tilefile.cpp "../GL Dependencies/glad.c" -ldl -o tests
+	Usage:
+		./tests				exits with a non zero status if any check fails
+*/
+
+#define COUNT_HEAP_ALLOCATIONS		// count allocations made by chunk loading - this is the only translation unit including heapcounter.h
+#include "heapcounter.h"
+#include "arena.h"
+#include "cache.h"
+#include "chunk.h"
+#include "concurrentqueue.h"
+#include "frustum.h"
+#include "noise.h"
+#include "threadpool.h"
+#include "tilecache.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { failures++; printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition); } } while (0)
+
+// true if a and b agree to within tolerance
+static bool approx(float a, float b, float tolerance) {
+	return std::fabs(a - b) <= tolerance;
+}
+
+// a chunk generated on its own, outside of any cache - the reference terrain cached chunks are compared against
+struct ReferenceChunk {
+	std::vector<float> heights, mesh;
+	Chunk chunk;
+	ReferenceChunk(int chunkx, int chunkz) : heights(Chunk::heightElements()), mesh(Chunk::meshElements()) {
+		chunk.attach(heights.data());
+		chunk.generate(chunkx, chunkz, mesh.data());
+	}
+};
+
+// world coordinate of a point inside the given chunk along one axis - f in [0, 1] spans the chunk
+static float inside(int chunkcoord, float f) {
+	return (float)(chunkcoord * Chunk::width()) + (f - 0.5f) * 0.98f * Chunk::width();
+}
+
+// draws (requests) a chunk and uploads loaded chunks until the cache answers height queries inside it from the generated
+// chunk rather than the estimate - returns false if the chunk does not load within a few seconds
+static bool load(Cache& cache, int chunkx, int chunkz) {
+	ReferenceChunk reference(chunkx, chunkz);
+	float wx = inside(chunkx, 0.3f), wz = inside(chunkz, 0.6f);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (std::chrono::steady_clock::now() < deadline) {
+		cache.draw(chunkx, chunkz, 0);
+		cache.render();
+		cache.pollInitRequests();
+		if (cache.getHeight(wx, wz) == reference.chunk.getHeight(wx, wz)) return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+// true if the cache answers height queries inside the given chunk exactly as the reference chunk does
+static bool cached(const Cache& cache, int chunkx, int chunkz) {
+	ReferenceChunk reference(chunkx, chunkz);
+	for (float f = 0.05f; f < 1.0f; f += 0.1f) {
+		float wx = inside(chunkx, f), wz = inside(chunkz, 1.0f - f);
+		if (cache.getHeight(wx, wz) != reference.chunk.getHeight(wx, wz)) return false;
+	}
+	return true;
+}
+
+// nested parallelFor calls cover every index exactly once, and a worker-less pool runs everything on the calling thread
+static void testThreadPool() {
+	ThreadPool pool(3);
+	const int outer = 16, inner = 100;
+	std::vector<std::atomic<int>> hits(outer * inner);
+	for (std::atomic<int>& h : hits) h = 0;
+	pool.parallelFor(0, outer, [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			pool.parallelFor(0, inner, [&, i](int begin, int end) {		// waiting threads run pending bands - no deadlock
+				for (int j = begin; j < end; j++) hits[i * inner + j]++;
+			});
+		}
+	});
+	int wrong = 0;
+	for (std::atomic<int>& h : hits) wrong += h != 1;
+	CHECK(wrong == 0);
+
+	ThreadPool serial(0);
+	CHECK(serial.size() == 0);
+	CHECK(serial.bands() == 1);
+	std::thread::id caller = std::this_thread::get_id();
+	int covered = 0;
+	bool elsewhere = false;
+	serial.parallelFor(0, 50, 7, [&](int first, int last) {
+		covered += last - first;
+		elsewhere |= std::this_thread::get_id() != caller;
+	});
+	CHECK(covered == 50);
+	CHECK(!elsewhere);
+	bool ran = false;
+	serial.submit([&ran] { ran = true; });
+	CHECK(ran);									// submitted work runs immediately
+	CHECK(!serial.runPending());
+}
+
+// waitPopBest returns the lowest scores first, keeps FIFO order among ties, drops cancelled items and wakes on push.
+// a full queue makes room by dropping cancelled items
+static void testLoadQueue() {
+	ConcurrentQueue<int> queue(16);
+	for (int v : { 5, -1, 3, 8, -4, 3, 1 }) queue.push(v);
+	std::vector<int> out;
+	auto score = [](int v) { return (float)(v % 100); };
+	auto cancelled = [](int v) { return v < 0; };
+	CHECK(queue.waitPopBest(out, 3, score, cancelled));
+	CHECK(out.size() == 3 && out[0] == 1 && out[1] == 3 && out[2] == 3);
+	CHECK(queue.size() == 2);					// both cancelled items are gone
+	out.clear();
+	queue.push(103);							// scores 3 like the earlier ties, but was queued after them
+	queue.push(-7);
+	CHECK(queue.waitPopBest(out, 10, score, cancelled));
+	CHECK(out.size() == 3 && out[0] == 103 && out[1] == 5 && out[2] == 8);
+	CHECK(queue.empty());
+
+	out.clear();
+	std::thread producer([&queue] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		queue.push(-2);							// cancelled - the consumer keeps waiting
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		queue.push(42);
+	});
+	CHECK(queue.waitPopBest(out, 4, score, cancelled));
+	CHECK(out.size() == 1 && out[0] == 42);
+	producer.join();
+
+	ConcurrentQueue<int> full(4);
+	for (int v : { 1, -2, 3, -4 }) CHECK(full.push(v));
+	int dropped = 0;
+	CHECK(full.push(5, [&dropped](int v) { dropped += v < 0; return v < 0; }));	// never blocks - both cancelled items make room
+	CHECK(dropped == 2 && full.size() == 3);
+	int front = 0;
+	CHECK(full.tryPop(front) && front == 1);	// survivors keep their order
+	CHECK(full.tryPop(front) && front == 3);
+	CHECK(full.tryPop(front) && front == 5);
+	CHECK(!full.tryPop(front));
+
+	queue.close();
+	CHECK(!queue.waitPopBest(out, 4, score, cancelled));
+	CHECK(!queue.push(1));						// closed queues refuse pushes
+}
+
+// boxes in front of the camera intersect its frustum, boxes behind, beside or past the far plane do not
+static void testFrustum() {
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f) * view);
+	CHECK(frustum.intersects(glm::vec3(-1.0f, -1.0f, -11.0f), glm::vec3(1.0f, 1.0f, -9.0f)));		// ahead
+	CHECK(!frustum.intersects(glm::vec3(-1.0f, -1.0f, 9.0f), glm::vec3(1.0f, 1.0f, 11.0f)));		// behind
+	CHECK(!frustum.intersects(glm::vec3(20.0f, -1.0f, -11.0f), glm::vec3(22.0f, 1.0f, -9.0f)));	// right of a 90 degree view at depth 10
+	CHECK(!frustum.intersects(glm::vec3(-1.0f, 15.0f, -11.0f), glm::vec3(1.0f, 17.0f, -9.0f)));	// above
+	CHECK(!frustum.intersects(glm::vec3(-1.0f, -1.0f, -150.0f), glm::vec3(1.0f, 1.0f, -120.0f)));	// past the far plane
+	CHECK(frustum.intersects(glm::vec3(8.0f, -1.0f, -11.0f), glm::vec3(12.0f, 1.0f, -9.0f)));		// straddling the right plane
+	CHECK(frustum.intersects(glm::vec3(-1.0f, -1.0f, -2.0f), glm::vec3(1.0f, 1.0f, 5.0f)));		// straddling the near plane
+	CHECK(Frustum().intersects(glm::vec3(1e6f), glm::vec3(1e6f + 1.0f)));						// the default frustum contains everything
+}
+
+// every level of detail covers the chunk exactly once with consistently wound triangles, and keeps every full
+// resolution vertex along the chunk boundary so neighbouring chunks at different levels never crack
+static void testIndexTopology() {
+	int vdim = (int)std::lround(std::sqrt((double)Chunk::heightElements()));
+	int dim = vdim - 1;
+	for (int lod = 0; lod < Chunk::lodLevels(); lod++) {
+		std::vector<int> tris = Chunk::triangles(lod);
+		std::map<std::pair<int, int>, int> edges;	// directed edge -> # triangles using it
+		double area = 0.0;
+		int flipped = 0, outside = 0;
+		for (size_t t = 0; t + 2 < tris.size(); t += 3) {
+			int v[3] = { tris[t], tris[t + 1], tris[t + 2] };
+			for (int k = 0; k < 3; k++) {
+				outside += v[k] < 0 || v[k] >= vdim * vdim;
+				edges[std::make_pair(v[k], v[(k + 1) % 3])]++;
+			}
+			int ax = v[0] % vdim, az = v[0] / vdim, bx = v[1] % vdim, bz = v[1] / vdim, cx = v[2] % vdim, cz = v[2] / vdim;
+			double cross = (double)(bx - ax) * (cz - az) - (double)(bz - az) * (cx - ax);	// counter clockwise in (x, z) is positive
+			flipped += cross <= 0.0;
+			area += 0.5 * std::fabs(cross);
+		}
+		int duplicated = 0, open = 0, boundary = 0;
+		for (const auto& e : edges) {
+			duplicated += e.second > 1;
+			if (edges.count(std::make_pair(e.first.second, e.first.first))) continue;
+			int ax = e.first.first % vdim, az = e.first.first / vdim, bx = e.first.second % vdim, bz = e.first.second / vdim;
+			bool onBorder = (ax == bx && (ax == 0 || ax == dim) && std::abs(az - bz) == 1) || (az == bz && (az == 0 || az == dim) && std::abs(ax - bx) == 1);
+			if (onBorder) boundary++;
+			else open++;							// an unmatched edge inside the chunk is a crack
+		}
+		CHECK(!tris.empty() && tris.size() % 3 == 0);
+		CHECK(outside == 0);
+		CHECK(flipped == 0);
+		CHECK(duplicated == 0);
+		CHECK(open == 0);
+		CHECK(boundary == 4 * dim);
+		CHECK(area == (double)dim * dim);
+	}
+}
+
+// batched noise kernels against glm::simplex, and the analytic gradient against finite differences
+static void testNoise() {
+	const int count = 1000;						// not a multiple of the vector width - covers the scalar remainder
+	std::vector<float> x(count), y(count), out(count), dx(count), dy(count), value(count);
+	for (int i = 0; i < count; i++) {
+		x[i] = -300.0f + 0.6173f * i;			// negative and positive coordinates, off the lattice
+		y[i] = 170.0f - 0.3911f * i;
+	}
+	Noise::simplex(x.data(), y.data(), out.data(), count);
+	Noise::simplex(x.data(), y.data(), value.data(), dx.data(), dy.data(), count);
+	for (int i = 0; i < count; i++) {
+		float expected = glm::simplex(glm::vec2(x[i], y[i]));
+		CHECK(approx(out[i], expected, 1e-5f));
+		CHECK(approx(value[i], expected, 1e-5f));
+		const float h = 1e-3f;
+		float fdx = (glm::simplex(glm::vec2(x[i] + h, y[i])) - glm::simplex(glm::vec2(x[i] - h, y[i]))) / (2 * h);
+		float fdy = (glm::simplex(glm::vec2(x[i], y[i] + h)) - glm::simplex(glm::vec2(x[i], y[i] - h))) / (2 * h);
+		CHECK(approx(dx[i], fdx, 2e-2f * (1.0f + std::fabs(fdx))));	// finite differences of single precision noise are only good to about a percent
+		CHECK(approx(dy[i], fdy, 2e-2f * (1.0f + std::fabs(fdy))));
+	}
+}
+
+// Chunk::getHeight interpolates the triangles of the full detail mesh
+static void testChunkHeight() {
+	ReferenceChunk reference(-2, 3);
+	const Chunk& chunk = reference.chunk;
+	const float* field = chunk.heightField();
+	int vdim = (int)std::lround(std::sqrt((double)Chunk::heightElements()));
+	float scale = (float)Chunk::width() / (vdim - 1);
+	float x0 = chunk.boundsMin().x, z0 = chunk.boundsMin().z;
+	auto vertex = [&](int x, int z) { return field[z * vdim + x]; };
+
+	// exact at vertices, and the vertices hold the generated terrain
+	for (int z = 0; z < vdim; z += 7) {
+		for (int x = 0; x < vdim; x += 5) {
+			float wx = x0 + x * scale, wz = z0 + z * scale;
+			CHECK(approx(chunk.getHeight(wx, wz), vertex(x, z), 1e-4f));
+			CHECK(approx(vertex(x, z), Chunk::computeHeight(wx, wz), 1e-3f));
+		}
+	}
+
+	// linear along cell edges
+	for (int i = 1; i < vdim - 1; i += 9) {
+		float mid = x0 + (i + 0.5f) * scale;
+		CHECK(approx(chunk.getHeight(mid, z0 + i * scale), 0.5f * (vertex(i, i) + vertex(i + 1, i)), 1e-4f));
+		CHECK(approx(chunk.getHeight(x0 + i * scale, z0 + (i + 0.5f) * scale), 0.5f * (vertex(i, i) + vertex(i, i + 1)), 1e-4f));
+	}
+
+	// continuous across the diagonal splitting each cell - both triangles agree on the shared edge
+	for (int i = 0; i < vdim - 1; i += 6) {
+		float wx = x0 + (i + 0.25f) * scale, wz = z0 + (i + 0.75f) * scale;
+		float below = chunk.getHeight(wx - 1e-3f, wz - 1e-3f), above = chunk.getHeight(wx + 1e-3f, wz + 1e-3f);
+		CHECK(approx(below, above, 1e-2f));
+		CHECK(approx(chunk.getHeight(wx, wz), 0.25f * vertex(i + 1, i) + 0.75f * vertex(i, i + 1), 1e-3f));
+	}
+
+	// clamped to the nearest edge outside of the chunk
+	float offset = (float)Chunk::width();
+	CHECK(chunk.getHeight(x0 - offset, z0 + 10 * scale) == chunk.getHeight(x0, z0 + 10 * scale));
+	CHECK(chunk.getHeight(x0 + 3 * scale, z0 + 2 * offset) == chunk.getHeight(x0 + 3 * scale, z0 + (vdim - 1) * scale));
+}
+
+// a headless cache loads requested chunks, keeps them through small domain shifts and drops the ones shifted out
+static void testCacheShifts() {
+	Cache cache(0, 0, nullptr, "");				// no GPU storage, no tiles - every chunk is generated
+	CHECK(load(cache, 5, 5));
+	CHECK(cached(cache, 5, 5));
+	CHECK(load(cache, 29, 0));					// far edge of the domain - no shift
+	CHECK(cached(cache, 5, 5));
+
+	CHECK(load(cache, 33, 5));					// shift east by 4 - chunk (5, 5) is still inside the domain
+	CHECK(cached(cache, 5, 5));
+	CHECK(cached(cache, 33, 5));
+
+	CHECK(load(cache, 5, -3));					// shift south by 3
+	CHECK(cached(cache, 5, 5));
+	CHECK(cached(cache, 5, -3));
+
+	CHECK(load(cache, 40, 5));					// shift east by 7 more - column 5 leaves the domain
+	CHECK(!cached(cache, 5, 5));
+	CHECK(cached(cache, 33, 5));
+	CHECK(cached(cache, 40, 5));
+	CHECK(cache.getHeight(inside(5, 0.5f), inside(5, 0.5f)) == Chunk::estimateHeight(inside(5, 0.5f), inside(5, 0.5f)));
+}
+
+// jumps of a domain width or more that are not a multiple of it (ie. teleports) keep chunks in the slots height queries read
+static void testCacheTeleports() {
+	const int ref = -15;
+	Cache east(ref, ref, nullptr, "");
+	CHECK(load(east, 0, 0));
+	CHECK(load(east, ref + Cache::dim() - 1 + 45, 0));	// shift east by 45
+	CHECK(!cached(east, 0, 0));
+	CHECK(load(east, ref + Cache::dim() + 45, 0));		// then by one more column
+	CHECK(cached(east, ref + Cache::dim() - 1 + 45, 0));
+
+	Cache west(ref, ref, nullptr, "");
+	CHECK(load(west, ref - 267, ref));					// shift west by 267
+	CHECK(load(west, ref - 267, ref - 2));				// then south by 2
+	CHECK(cached(west, ref - 267, ref));
+	CHECK(load(west, ref - 268 + Cache::dim(), ref));	// east edge of the shifted domain - no shift
+	CHECK(cached(west, ref - 267, ref));
+}
+
+// batched height queries agree with single queries, on loaded chunks and on the estimate elsewhere
+static void testBatchedHeights() {
+	Cache cache(0, 0, nullptr, "");
+	CHECK(load(cache, 2, 1));
+	const int count = 300;						// several miss batches, with loaded and unloaded points interleaved
+	std::vector<float> x(count), z(count), out(count), estimate(count);
+	for (int i = 0; i < count; i++) {
+		x[i] = inside(i % 3 == 0 ? 2 : 7, (i % 97) / 97.0f);
+		z[i] = inside(1, (i % 89) / 89.0f);
+	}
+	cache.getHeights(x.data(), z.data(), out.data(), count);
+	for (int i = 0; i < count; i++) CHECK(approx(out[i], cache.getHeight(x[i], z[i]), 1e-4f));
+	Chunk::estimateHeights(x.data(), z.data(), estimate.data(), count);
+	for (int i = 0; i < count; i++) CHECK(approx(estimate[i], Chunk::estimateHeight(x[i], z[i]), 1e-4f));
+}
+
+// the tile directory is trimmed to its limit, foreign tiles are removed, and tiles written by the loader are read back
+static void testTiles() {
+	const std::string dir = Chunk::triangleStrips() ? "terrain_tests_tiles" : "terrain_tests_tiles_lists";	// both suites may run at once
+	{ TileCache clear(dir, 0); }				// remove tiles left behind by an earlier run
+	const std::string foreign = dir + "/0000000000000000_0_0.tile";
+	FILE* f = fopen(foreign.c_str(), "wb");
+	CHECK(f != nullptr);
+	if (f) fclose(f);
+
+	TileCache tiles(dir, 4);
+	f = fopen(foreign.c_str(), "rb");
+	CHECK(f == nullptr);						// written under another terrain hash
+	if (f) fclose(f);
+	ReferenceChunk reference(0, 0);
+	for (int i = 0; i < 10; i++) CHECK(tiles.write(i, 0, reference.chunk, reference.mesh.data()));
+	int present = 0;
+	for (int i = 0; i < 10; i++) {
+		TileCache::Tile tile;
+		if (tiles.open(i, 0, tile)) present++;
+		TileCache::close(tile);
+	}
+	CHECK(present == 4);
+
+	{
+		Cache writer(0, 0, nullptr, dir);
+		CHECK(load(writer, 3, -2));
+	}
+	Cache reader(0, 0, nullptr, dir);
+	CHECK(load(reader, 3, -2));
+	CHECK(reader.chunksGenerated() == 0);		// read back from the tile written by the first cache
+	{ TileCache clear(dir, 0); }
+}
+
+// requests a window of chunks (x, z) in [firstx, firstx + width) x [0, width) and uploads until the given total number
+// of chunks has been generated and uploaded, then keeps pumping briefly so the loader finishes its bookkeeping
+// makes no heap allocations of its own. returns false if loading stalls
+static bool fly(Cache& cache, int firstx, int width, size_t generated) {
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	auto settled = deadline;
+	while (std::chrono::steady_clock::now() < settled) {
+		for (int z = 0; z < width; z++) {
+			for (int x = firstx; x < firstx + width; x++) cache.draw(x, z, 0);
+		}
+		cache.render();
+		cache.pollInitRequests();
+		if (settled == deadline && cache.chunksGenerated() >= generated && cache.pendingUploads() == 0)
+			settled = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+		if (std::chrono::steady_clock::now() >= deadline) return false;
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	return true;
+}
+
+// once warmed up, chunk loading makes no heap allocations - while flying east the domain shifts every step, so slots
+// are invalidated, requeued, regenerated and uploaded in steady state
+static void testSteadyStateAllocations() {
+	Cache cache(0, 0, nullptr, "");
+	const int width = 3;
+	bool loaded = true;
+	for (int step = 0; step < 40; step++) loaded &= fly(cache, step, width, (size_t)(width * width + width * step));	// warm up, past the first domain shift
+	size_t warm = cache.allocations();
+	for (int step = 40; step < 100; step++) loaded &= fly(cache, step, width, (size_t)(width * width + width * step));
+	CHECK(loaded);
+	CHECK(cache.chunksGenerated() == (size_t)(width * width + width * 99));
+	CHECK(cache.allocations() == warm);
+	if (cache.allocations() != warm) printf("  %zu allocations after warm up, %zu after flying on\n", warm, cache.allocations());
+}
+
+// a load whose slot is recycled before it completes is cancelled - the slot never reports the old chunk
+static void testStaleLoads() {
+	Cache cache(0, 0, nullptr, "");
+	cache.draw(0, 0, 0);						// queue chunk (0, 0) ...
+	cache.draw(Cache::dim(), 0, 0);				// ... then immediately shift its column onto chunk (dim, 0), recycling the slot
+	CHECK(load(cache, Cache::dim(), 0));
+	CHECK(cached(cache, Cache::dim(), 0));
+	CHECK(!cached(cache, 0, 0));
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+	while (std::chrono::steady_clock::now() < deadline) cache.pollInitRequests();	// drain whatever the loader still produces
+	CHECK(cached(cache, Cache::dim(), 0));
+	CHECK(!cached(cache, 0, 0));
+}
+
+int main() {
+	testThreadPool();
+	testLoadQueue();
+	testFrustum();
+	testIndexTopology();
+	testNoise();
+	testChunkHeight();
+	testCacheShifts();
+	testCacheTeleports();
+	testBatchedHeights();
+	testTiles();
+	testSteadyStateAllocations();
+	testStaleLoads();
+	if (failures) printf("%d checks failed\n", failures);
+	else printf("all checks passed\n");
+	return failures ? 1 : 0;
+}
@@ -4,9 +4,13 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "aliases.h"
+#include "threadpool.h"
 #include <glad/glad.h>		// OpenGL function pointers
+#include <atomic>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 /*
 	COSC 3P98 - Term Project
@@ -55,4 +59,138 @@ public:
 	}
 };
 
+/*
+	Loads a set of equally sized images into the layers of a single GL_TEXTURE_2D_ARRAY
+	Images are decoded, and their mip chains built, on a thread pool as soon as the array is constructed - upload waits for
+	decoding to finish and uploads every layer from the calling thread, which must own the opengl context.
+	Construct early (ie. before compiling shaders) so decoding overlaps other startup work.
+*/
+class TextureArray {
+private:
+
+	// one decoded image with its mip chain, each level stored after the previous one as tightly packed RGBA8
+	struct Layer {
+		std::string file;
+		std::vector<unsigned char> pixels;
+		int width = 0, height = 0;
+	};
+
+	// instance data
+	std::vector<Layer> layers;
+	std::atomic<int> pending;		// # layers still being decoded
+	ThreadPool& pool;
+
+	// helper functions
+	static int mipLevels(int w, int h) {			// # levels in a full mip chain of a w x h image
+		int levels = 1;
+		while (w > 1 || h > 1) {
+			w = std::max(w / 2, 1);
+			h = std::max(h / 2, 1);
+			levels++;
+		}
+		return levels;
+	}
+	static void decode(Layer& layer) {			// decode an image as RGBA and append its mip chain - leaves pixels empty on failure
+		int channels;
+		unsigned char* img = stbi_load(layer.file.c_str(), &layer.width, &layer.height, &channels, 4);
+		if (!img) return;
+		size_t bytes = 0;
+		for (int level = 0, w = layer.width, h = layer.height; level < mipLevels(layer.width, layer.height); level++, w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+			bytes += (size_t)w * h * 4;
+		layer.pixels.resize(bytes);
+		std::copy(img, img + (size_t)layer.width * layer.height * 4, layer.pixels.begin());
+		stbi_image_free(img);
+		const unsigned char* src = layer.pixels.data();
+		unsigned char* dst = layer.pixels.data() + (size_t)layer.width * layer.height * 4;
+		for (int w = layer.width, h = layer.height; w > 1 || h > 1; ) {		// box filter each level from the previous one
+			int nw = std::max(w / 2, 1), nh = std::max(h / 2, 1);
+			for (int y = 0; y < nh; y++) {
+				int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+				for (int x = 0; x < nw; x++) {
+					int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+					for (int c = 0; c < 4; c++) {
+						int sum = src[(y0 * w + x0) * 4 + c] + src[(y0 * w + x1) * 4 + c] + src[(y1 * w + x0) * 4 + c] + src[(y1 * w + x1) * 4 + c];
+						dst[(y * nw + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+					}
+				}
+			}
+			src = dst;
+			dst += (size_t)nw * nh * 4;
+			w = nw;
+			h = nh;
+		}
+	}
+	void wait() {								// block until every layer is decoded - runs pool tasks while waiting
+		while (pending.load(std::memory_order_acquire) > 0) {
+			if (!pool.runPending()) std::this_thread::yield();
+		}
+	}
+
+public:
+
+	uint id;
+	int width, height, levels;
+
+	// Constructor - starts decoding the given images, one array layer each in order, on the given pool
+	TextureArray(const std::vector<std::string>& files, ThreadPool& threadPool = ThreadPool::shared()) :
+		layers(files.size()), pending((int)files.size()), pool(threadPool), id(0), width(0), height(0), levels(0)
+	{
+		for (size_t i = 0; i < files.size(); i++) {
+			layers[i].file = files[i];
+			Layer* layer = &layers[i];
+			pool.submit([this, layer] {
+				decode(*layer);
+				pending.fetch_sub(1, std::memory_order_release);
+			});
+		}
+	}
+
+	~TextureArray() {
+		wait();									// decode tasks reference this array
+		if (id) glDeleteTextures(1, &id);
+	}
+
+	// delete copy
+	TextureArray(const TextureArray& other) = delete;
+	TextureArray& operator=(const TextureArray& other) = delete;
+
+	// wait for decoding to finish and upload every layer and mip level to a new texture array. exits if an image failed to load
+	void upload() {
+		wait();
+		for (const Layer& layer : layers) {
+			if (layer.pixels.empty()) {
+				printf("FATAL: Texture \"%s\" Load Failed.\n", layer.file.c_str());
+				exit(EXIT_FAILURE);
+			}
+			if (layer.width != layers[0].width || layer.height != layers[0].height) {
+				printf("FATAL: Texture \"%s\" is %dx%d, texture array layers must all be %dx%d.\n", layer.file.c_str(), layer.width, layer.height, layers[0].width, layers[0].height);
+				exit(EXIT_FAILURE);
+			}
+		}
+		width = layers[0].width;
+		height = layers[0].height;
+		levels = mipLevels(width, height);
+
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		size_t offset = 0;
+		for (int level = 0, w = width, h = height; level < levels; level++, w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, w, h, (GLsizei)layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			for (size_t i = 0; i < layers.size(); i++)
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, (GLint)i, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, layers[i].pixels.data() + offset);
+			offset += (size_t)w * h * 4;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		for (Layer& layer : layers) std::vector<unsigned char>().swap(layer.pixels);	// release decoded images
+	}
+};
+
 #endif
\ No newline at end of file
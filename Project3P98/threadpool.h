@@ -0,0 +1,233 @@
+#ifndef CS3P98_THREAD_POOL_H
+#define CS3P98_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Work Stealing Thread Pool
+
+	Maintains a fixed set of persistent worker threads, each owning its own task deque. Workers pop their newest
+	task first (good cache locality for nested work) and steal the oldest task of another worker when their own
+	deque runs dry. Threads are only ever created when the pool is constructed, never while submitting work.
+
+	Threads waiting on submitted work through parallelFor execute pending tasks themselves instead of blocking,
+	so pool tasks may safely submit and wait on nested work (ie. a chunk load task splitting its mesh into bands).
+
+	A pool constructed with zero workers runs all work serially on the calling thread.
+
+	Task deques are fixed capacity ring buffers allocated up front, so queueing work never allocates (tasks whose captures
+	fit std::function's local buffer, like parallelFor bands, are not allocated either). A task submitted to a full deque
+	runs immediately on the submitting thread instead.
+*/
+class ThreadPool {
+private:
+
+	typedef std::function<void()> Task;
+
+	// class constants
+	static constexpr size_t QUEUE_CAPACITY = 256;		// default # tasks each deque holds - far above the bands * bands nested parallelFor tasks of chunk loading
+
+	// per worker task deque - fixed capacity ring buffer
+	struct WorkQueue {
+		std::mutex lock;
+		std::vector<Task> tasks;						// ring of capacity tasks
+		size_t head = 0;								// ring index of the oldest task
+		size_t count = 0;								// # queued tasks
+		explicit WorkQueue(size_t capacity) : tasks(std::max(capacity, (size_t)1)) {}
+		bool pushBack(Task& task) {						// false if full
+			if (count == tasks.size()) return false;
+			tasks[(head + count++) % tasks.size()] = std::move(task);
+			return true;
+		}
+		bool popBack(Task& task) {						// newest task
+			if (count == 0) return false;
+			Task& slot = tasks[(head + --count) % tasks.size()];
+			task = std::move(slot);
+			slot = nullptr;
+			return true;
+		}
+		bool popFront(Task& task) {						// oldest task
+			if (count == 0) return false;
+			Task& slot = tasks[head];
+			task = std::move(slot);
+			slot = nullptr;
+			head = (head + 1) % tasks.size();
+			count--;
+			return true;
+		}
+	};
+
+	// shared state of a single parallelFor call - lives on the stack of the waiting thread
+	template <typename F>
+	struct ForJob {
+		F& body;
+		int begin, end, bands;
+		std::atomic<int> remaining;
+		ForJob(F& f, int b, int e, int n) : body(f), begin(b), end(e), bands(n), remaining(n) {}
+		void run(int band) {
+			body(begin + (end - begin) * band / bands, begin + (end - begin) * (band + 1) / bands);
+			remaining.fetch_sub(1, std::memory_order_release);
+		}
+	};
+
+	// instance data
+	std::vector<std::unique_ptr<WorkQueue>> queues;		// one task deque per worker
+	std::vector<std::thread> workers;					// persistent worker threads
+	std::mutex sleepLock;								// guards idle workers going to sleep
+	std::condition_variable wake;						// signalled whenever work is submitted
+	std::atomic<int> queued;							// # tasks submitted but not yet started
+	std::atomic<bool> running;							// cleared on destruction to stop workers
+	std::atomic<unsigned int> nextQueue;				// round robin queue selection for external submitters
+
+	static thread_local ThreadPool* currentPool;		// pool that owns the calling thread (nullptr if not a worker)
+	static thread_local int currentIndex;				// queue index of the calling worker thread
+
+	// helper functions
+	inline int homeQueue() {							// queue owned by calling thread, -1 if caller is not one of our workers
+		return currentPool == this ? currentIndex : -1;
+	}
+	void push(Task task) {
+		int home = homeQueue();
+		WorkQueue& q = *queues[home >= 0 ? home : nextQueue++ % queues.size()];
+		bool pushed;
+		{
+			std::lock_guard<std::mutex> lk(q.lock);
+			pushed = q.pushBack(task);
+			if (pushed) queued++;
+		}
+		if (!pushed) {									// deque full - run the task here rather than grow it
+			task();
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lk(sleepLock);	// ensure a worker about to sleep observes the new task
+		}
+		wake.notify_one();
+	}
+	bool tryPop(int home, Task& task) {
+		if (home >= 0) {								// newest task from our own deque first
+			WorkQueue& q = *queues[home];
+			std::lock_guard<std::mutex> lk(q.lock);
+			if (q.popBack(task)) {
+				queued--;
+				return true;
+			}
+		}
+		const int n = (int)queues.size();
+		const int start = home >= 0 ? home + 1 : 0;
+		for (int i = 0; i < n; i++) {					// otherwise steal the oldest task of another worker
+			WorkQueue& q = *queues[(start + i) % n];
+			std::lock_guard<std::mutex> lk(q.lock);
+			if (q.popFront(task)) {
+				queued--;
+				return true;
+			}
+		}
+		return false;
+	}
+	void workerLoop(int index) {
+		currentPool = this;
+		currentIndex = index;
+		Task task;
+		while (running) {
+			if (tryPop(index, task)) {
+				task();
+				task = nullptr;
+				continue;
+			}
+			std::unique_lock<std::mutex> lk(sleepLock);
+			wake.wait(lk, [this] { return !running || queued > 0; });
+		}
+	}
+
+public:
+
+	// number of workers used by the default constructor - leaves one hardware thread free for the render loop
+	static unsigned int defaultThreads() {
+		unsigned int hw = std::thread::hardware_concurrency();
+		return hw > 2 ? hw - 1 : 1;
+	}
+
+	// process wide pool shared by all terrain generation work
+	static ThreadPool& shared() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	// Constructor - spawns all worker threads up front, each with a deque of queueCapacity tasks
+	explicit ThreadPool(unsigned int threads = defaultThreads(), size_t queueCapacity = QUEUE_CAPACITY) : queued(0), running(true), nextQueue(0) {
+		for (unsigned int i = 0; i < std::max(threads, 1u); i++) queues.emplace_back(new WorkQueue(queueCapacity));	// a worker-less pool keeps one queue so runPending stays valid
+		workers.reserve(threads);
+		for (unsigned int i = 0; i < threads; i++) workers.emplace_back(&ThreadPool::workerLoop, this, (int)i);
+	}
+
+	// Destructor - stop and join workers. Tasks still queued are discarded
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lk(sleepLock);
+			running = false;
+		}
+		wake.notify_all();
+		for (std::thread& t : workers) t.join();
+	}
+
+	// delete copy and move
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+	// number of worker threads
+	unsigned int size() const { return (unsigned int)workers.size(); }
+
+	// suggested number of bands to split data parallel work into - one per worker plus the calling thread
+	unsigned int bands() const { return size() + 1; }
+
+	// queue a task for asynchronous execution - runs it immediately if the pool has no workers
+	void submit(Task task) {
+		if (workers.empty()) task();
+		else push(std::move(task));
+	}
+
+	// execute one pending task on the calling thread. returns false if there was nothing to run
+	bool runPending() {
+		Task task;
+		if (!tryPop(homeQueue(), task)) return false;
+		task();
+		return true;
+	}
+
+	// splits [begin, end) into the given number of contiguous bands and calls body(bandBegin, bandEnd) for each in parallel
+	// blocks until every band has completed - the calling thread works on bands (or any other pending task) while waiting
+	template <typename F>
+	void parallelFor(int begin, int end, int numBands, F&& body) {
+		if (end <= begin) return;
+		if (numBands > end - begin) numBands = end - begin;
+		if (numBands <= 1) {
+			body(begin, end);
+			return;
+		}
+		ForJob<F> job(body, begin, end, numBands);
+		ForJob<F>* jp = &job;
+		for (int band = 1; band < numBands; band++) push([jp, band] { jp->run(band); });	// small capture - fits std::function's local buffer
+		job.run(0);
+		while (job.remaining.load(std::memory_order_acquire) > 0) {
+			if (!runPending()) std::this_thread::yield();
+		}
+	}
+	template <typename F>
+	void parallelFor(int begin, int end, F&& body) {
+		parallelFor(begin, end, (int)bands(), std::forward<F>(body));
+	}
+};
+
+// Initialize static values
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local int ThreadPool::currentIndex = -1;
+
+#endif
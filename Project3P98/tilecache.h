@@ -0,0 +1,186 @@
+#ifndef CS3P98_TILE_CACHE_H
+#define CS3P98_TILE_CACHE_H
+
+#include "chunk.h"
+#include "tilefile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+	Tile Cache
+	Persists generated terrain chunks to disk as binary tiles so chunks that are revisited (or reloaded after a restart)
+	are read back instead of regenerated.
+
+	One tile per chunk: a fixed header followed by the chunk's height field and its mesh data for GPU upload, exactly as
+	produced by Chunk::generate. Tiles are read through a read only memory mapping - the mesh data is uploaded straight
+	out of the mapping without being copied, only the height field is copied into the chunk's resident storage.
+
+	Tiles are keyed by Chunk::terrainHash (every constant computeHeight and the vertex format depend on) and the chunk
+	coordinate. Changing any of those constants changes the key, so stale tiles are never read. Bump VERSION whenever
+	the tile layout or the generation algorithm changes in a way the constants do not capture.
+
+	The directory holds at most a fixed number of tiles - reading a tile marks it as used (its modification time), and
+	once writes overflow the limit the least recently used tiles are removed. Tiles keyed by another terrain hash can
+	never be read again and are removed as well, along with temporary files left behind by an interrupted write.
+
+	Tiles may be opened and written from any number of threads at once.
+*/
+class TileCache {
+public:
+
+	// read only view of a tile on disk - must be released through TileCache::close
+	struct Tile {
+		const void* data = nullptr;				// start of the mapping, nullptr if no tile is open
+		size_t size = 0;						// mapping size in bytes
+		const float* heights() const { return reinterpret_cast<const float*>(static_cast<const char*>(data) + sizeof(Header)); }
+		const float* mesh() const { return heights() + Chunk::heightElements(); }
+		float minHeight() const { return static_cast<const Header*>(data)->minHeight; }
+		float maxHeight() const { return static_cast<const Header*>(data)->maxHeight; }
+	};
+
+private:
+
+	// tile file header - followed by heightElements() height floats and meshElements() mesh floats
+	struct Header {
+		char magic[4];							// "3PTT"
+		uint32_t version;						// tile format version
+		uint64_t terrain;						// Chunk::terrainHash of the generator that wrote the tile
+		int32_t chunkx, chunkz;					// chunk coordinate
+		float minHeight, maxHeight;				// vertical extent of the chunk
+		uint32_t heightCount, meshCount;		// # floats in each section
+	};
+
+	// class constants
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t MAX_PATH_LENGTH = 512;
+	static constexpr size_t TILE_SIZE = sizeof(Header) + (Chunk::heightElements() + Chunk::meshElements()) * sizeof(float);
+	static constexpr size_t MAX_TILES = 4096;	// default tile limit - about 280 MB in the full vertex format, 4.5 cache volumes
+
+	// instance data
+	std::string directory;						// tile directory, with trailing separator
+	uint64_t terrain;							// key of the tiles written and accepted by this cache
+	bool enabled;								// false if the tile directory could not be created
+	size_t maxTiles;							// # tiles kept on disk - see trim
+	std::atomic<size_t> tileCount;				// # tiles in the directory - approximate while writes race a trim
+	std::mutex trimLock;						// held by the thread trimming the directory
+
+	// helper functions
+	bool path(int chunkx, int chunkz, char* out, size_t size, const char* suffix = "") const {	// tile file name for a chunk coordinate - built without allocating
+		int n = snprintf(out, size, "%s%016llx_%d_%d.tile%s", directory.c_str(), (unsigned long long)terrain, chunkx, chunkz, suffix);
+		return n > 0 && (size_t)n < size;
+	}
+	static bool endsWith(const char* name, const char* suffix) {
+		size_t n = strlen(name), m = strlen(suffix);
+		return n >= m && strcmp(name + n - m, suffix) == 0;
+	}
+	void trim(bool startup) {					// remove foreign tiles, then the least recently used tiles beyond maxTiles
+		/*
+			Temporary files are only removed at startup - later on they may belong to a write in flight. Concurrent writes
+			may leave tileCount slightly off, which only moves the next trim earlier or later.
+		*/
+		char prefix[32];
+		snprintf(prefix, sizeof(prefix), "%016llx_", (unsigned long long)terrain);
+		std::vector<std::pair<uint64_t, std::string>> own;	// (modification time, name) of every tile with the current key
+		auto visit = [&](const char* name, uint64_t time) {
+			if (endsWith(name, ".tile.tmp")) {
+				if (startup) std::remove((directory + name).c_str());
+			}
+			else if (endsWith(name, ".tile")) {
+				if (strncmp(name, prefix, strlen(prefix)) == 0) own.emplace_back(time, name);
+				else std::remove((directory + name).c_str());	// written under another terrain hash - never read again
+			}
+		};
+		TileFile::forEachFile(directory, visit);
+		size_t kept = own.size();
+		if (own.size() > maxTiles) {
+			std::sort(own.begin(), own.end());	// least recently used first
+			for (size_t i = 0; i < own.size() - maxTiles; i++) {
+				if (std::remove((directory + own[i].second).c_str()) == 0) kept--;	// tiles mapped on Windows cannot be removed - kept for the next trim
+			}
+		}
+		tileCount = kept;
+	}
+
+public:
+
+	// Constructor - tiles are stored in (and read from) the given directory, created if necessary. at most maxTileCount
+	// tiles are kept - the directory is trimmed to that many immediately, and foreign tiles are removed
+	TileCache(const std::string& dir = "chunkcache", size_t maxTileCount = MAX_TILES) :
+		directory(dir + "/"), terrain(Chunk::terrainHash()), enabled(!dir.empty() && TileFile::makeDirectory(dir)), maxTiles(maxTileCount), tileCount(0)
+	{
+		if (enabled) trim(true);
+	}
+
+	// delete copy
+	TileCache(const TileCache& other) = delete;
+	TileCache& operator=(const TileCache& other) = delete;
+
+	// map the tile of the given chunk. returns false if there is no valid tile for it
+	bool open(int chunkx, int chunkz, Tile& tile) const {
+		char file[MAX_PATH_LENGTH];
+		if (!enabled || !path(chunkx, chunkz, file, sizeof(file))) return false;
+		TileFile::touch(file);					// mark the tile as used - before mapping, a mapped file may not be writable on every platform
+		if (!TileFile::map(file, tile.data, tile.size)) return false;
+		const Header* h = static_cast<const Header*>(tile.data);
+		if (tile.size != TILE_SIZE || memcmp(h->magic, "3PTT", 4) != 0 || h->version != VERSION || h->terrain != terrain ||
+			h->chunkx != chunkx || h->chunkz != chunkz ||
+			h->heightCount != (uint32_t)Chunk::heightElements() || h->meshCount != (uint32_t)Chunk::meshElements()) {
+			close(tile);						// truncated or foreign tile - regenerate and overwrite it
+			return false;
+		}
+		return true;
+	}
+
+	// release a tile mapped by open
+	static void close(Tile& tile) {
+		if (!tile.data) return;
+		TileFile::unmap(tile.data, tile.size);
+		tile.data = nullptr;
+		tile.size = 0;
+	}
+
+	// write the tile of a freshly generated chunk - mesh is the storage passed to Chunk::generate
+	// tiles are written to a temporary file first, so a reader never maps a partially written tile. the directory is
+	// trimmed back to its tile limit once writes overflow it by an eighth
+	bool write(int chunkx, int chunkz, const Chunk& chunk, const float* mesh) {
+		if (!enabled) return false;
+		Header h;
+		memcpy(h.magic, "3PTT", 4);
+		h.version = VERSION;
+		h.terrain = terrain;
+		h.chunkx = chunkx;
+		h.chunkz = chunkz;
+		h.minHeight = chunk.boundsMin().y;
+		h.maxHeight = chunk.boundsMax().y;
+		h.heightCount = Chunk::heightElements();
+		h.meshCount = Chunk::meshElements();
+		char file[MAX_PATH_LENGTH], temp[MAX_PATH_LENGTH];
+		if (!path(chunkx, chunkz, file, sizeof(file)) || !path(chunkx, chunkz, temp, sizeof(temp), ".tmp")) return false;
+		FILE* f = fopen(temp, "wb");
+		if (!f) return false;
+		bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+			fwrite(chunk.heightField(), sizeof(float), Chunk::heightElements(), f) == (size_t)Chunk::heightElements() &&
+			fwrite(mesh, sizeof(float), Chunk::meshElements(), f) == (size_t)Chunk::meshElements();
+		ok = fclose(f) == 0 && ok;
+		bool replaced = false;
+		if (ok) {
+			replaced = std::remove(file) == 0;	// rename does not replace existing files on every platform
+			ok = std::rename(temp, file) == 0;
+		}
+		if (!ok) std::remove(temp);
+		if (ok && !replaced && ++tileCount > maxTiles + maxTiles / 8) {
+			std::unique_lock<std::mutex> lk(trimLock, std::try_to_lock);	// one writer trims, the others carry on
+			if (lk.owns_lock()) trim(false);
+		}
+		return ok;
+	}
+};
+
+#endif
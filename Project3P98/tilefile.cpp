@@ -0,0 +1,101 @@
+/*
+	Tile File - platform implementation of the file system calls used by the tile cache (see tilefile.h)
+*/
+
+#include "tilefile.h"
+#include <cerrno>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <utime.h>
+#endif
+
+bool TileFile::map(const char* file, const void*& data, size_t& size) {
+#ifdef _WIN32
+	HANDLE f = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER length;
+	HANDLE m = GetFileSizeEx(f, &length) && length.QuadPart > 0 ? CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	CloseHandle(f);
+	if (!m) return false;
+	data = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(m);								// the view keeps the mapping alive
+	size = (size_t)length.QuadPart;
+#else
+	FILE* f = fopen(file, "rb");
+	if (!f) return false;
+	struct stat st;
+	void* p = fstat(fileno(f), &st) == 0 && st.st_size > 0 ? mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0) : MAP_FAILED;
+	fclose(f);									// the mapping keeps the file alive
+	if (p == MAP_FAILED) return false;
+	data = p;
+	size = (size_t)st.st_size;
+#endif
+	return data != nullptr;
+}
+
+void TileFile::unmap(const void* data, size_t size) {
+#ifdef _WIN32
+	(void)size;
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<void*>(data), size);
+#endif
+}
+
+bool TileFile::makeDirectory(const std::string& dir) {
+#ifdef _WIN32
+	return _mkdir(dir.c_str()) == 0 || errno == EEXIST;
+#else
+	return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+void TileFile::touch(const char* file) {
+#ifdef _WIN32
+	_utime(file, nullptr);
+#else
+	utime(file, nullptr);
+#endif
+}
+
+void TileFile::forEachFile(const std::string& dir, Visitor visit, void* context) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA fd;
+	HANDLE find = FindFirstFileA((dir + "*").c_str(), &fd);
+	if (find == INVALID_HANDLE_VALUE) return;
+	do {
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+		visit(context, fd.cFileName, ((uint64_t)fd.ftLastWriteTime.dwHighDateTime << 32) | fd.ftLastWriteTime.dwLowDateTime);
+	} while (FindNextFileA(find, &fd));
+	FindClose(find);
+#else
+	DIR* d = opendir(dir.c_str());
+	if (!d) return;
+	std::string file;
+	while (dirent* entry = readdir(d)) {
+		file = dir + entry->d_name;
+		struct stat st;
+		if (stat(file.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+#ifdef __APPLE__
+		visit(context, entry->d_name, (uint64_t)st.st_mtimespec.tv_sec * 1000000000ull + st.st_mtimespec.tv_nsec);
+#else
+		visit(context, entry->d_name, (uint64_t)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec);
+#endif
+	}
+	closedir(d);
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef CS3P98_TILE_FILE_H
+#define CS3P98_TILE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+	Tile File
+	The platform file system calls the tile cache needs - read only memory mapping, directory creation and listing, and
+	modification times. Implemented in tilefile.cpp so that no platform header (in particular windows.h, whose near / far
+	and min / max macros break unrelated code) reaches anything that includes the tile cache.
+*/
+class TileFile {
+public:
+
+	// called with every regular file of a directory - time is the file's modification time in platform ticks, only
+	// meaningful compared to other times from the same listing
+	typedef void (*Visitor)(void* context, const char* name, uint64_t time);
+
+	// map a whole file read only - returns false if it does not exist, is empty or cannot be mapped
+	static bool map(const char* file, const void*& data, size_t& size);
+
+	// release a mapping made by map
+	static void unmap(const void* data, size_t size);
+
+	// create a directory if it does not exist yet - returns false if it does not exist afterwards
+	static bool makeDirectory(const std::string& dir);
+
+	// set a file's modification time to now
+	static void touch(const char* file);
+
+	// call visit(context, name, time) for every regular file in dir - dir ends with a separator
+	static void forEachFile(const std::string& dir, Visitor visit, void* context);
+
+	// calls visit(name, time) for every regular file in dir
+	template <typename F>
+	static void forEachFile(const std::string& dir, F& visit) {
+		forEachFile(dir, [](void* context, const char* name, uint64_t time) { (*static_cast<F*>(context))(name, time); }, &visit);
+	}
+};
+
+#endif
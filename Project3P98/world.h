@@ -14,9 +14,12 @@
 #include "texture.h"
 #include "camera.h"
 #include "cache.h"
+#include "terrainbuffers.h"
+#include "profiler.h"
 #include "shader.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include <iostream>
 
 class World {
@@ -39,6 +42,7 @@ private:
 		}
 		int getx() { return x; }
 		int getz() { return z; }
+		int ring() { return std::max(abs(x), abs(z)); }		// # chunks between current coordinate and spiral origin
 		void reset() { x = 0; z = 0; leg = 0; layer = 1; }
 	};
 
@@ -47,26 +51,43 @@ private:
 	static constexpr int	RENDER_WIDTH = 2 * RENDER_RADIUS + 1;						// width of render area in # chunks - render width is always an odd number
 	static constexpr int	RENDER_VOLUME = RENDER_WIDTH * RENDER_WIDTH;				// # chunks to be rendered each pass
 	static constexpr float	WORLD_RENDER_DIST = (float)(Chunk::width() * RENDER_RADIUS);// maximum render distance in world space - using this will guarantee pop-in
+	static constexpr int	LOD_RING_WIDTH = 2;											// # rings of chunks drawn at each level of detail before switching to the next coarser level
+	static constexpr GLuint	FRAME_DATA_BINDING = 0;										// uniform buffer binding point of the FrameData block
 	const glm::vec3 origin;
 
+	// per frame state shared by every shader program - std140 layout of the FrameData uniform block declared in the shaders
+	struct FrameData {
+		glm::mat4 projectionViewMatrix;
+		glm::vec4 viewpos;								// xyz used - std140 pads vec3 to 16 bytes
+		glm::vec4 lightDirection;						// directional light (ie. the sun)
+		glm::vec4 lightDiffuse;
+		glm::vec4 lightAmbient;
+		glm::vec4 lightSpecular;
+	};
+	static_assert(sizeof(FrameData) == 144, "FrameData must match the std140 layout of the FrameData uniform block");
+
 	// helper functions
 	static inline int mapchunk(float x) {				// computes coordinate of chunk that provided world space position resides in
-		return (int)floor((x + Chunk::width() / 2) / (float)Chunk::width());
+		return Chunk::chunkCoord(x);
+	}
+	static inline int lod(int ring) {					// level of detail for chunks in the given ring around the active chunk
+		return std::min(ring / LOD_RING_WIDTH, Chunk::lodLevels() - 1);
 	}
 
 	// instance data
 	Camera&			cam;								// camera object - represents player position, direction, view
 	glm::vec2		activeChunk;						// coordinate of chunk that player position is within
+	TerrainBuffers	terrainBuffers;						// GPU storage of the cached terrain - lent to the cache
 	Cache			cache;								// terrain cache
 	SpiralIterator	spit;
+	TextureArray	terrainTextures;					// grass, sand and stone layers sampled by the chunk shader - declared before the shaders so images decode while they compile
 	Shader			chunkshader;						// shader programs used in world
 	Shader			waterShader;
 	Shader			modelShader;
 	Shader			testShader;
+	UniformBuffer<FrameData> frameData;					// camera and lighting state read by every shader program
 	glm::vec3		sunPosition;						// position of the sun in the world - directional light
-	Texture			grasstex;							// textures used in terrain
-	Texture			sandtex;
-	Texture			stonetex;
+	GpuTimer		gpuTimer;							// GPU time of the terrain pass while profiling
 	//glm::vec3		objspawn;
 	//Objective		obj;
 
@@ -77,84 +98,96 @@ public:
 	World(Camera& camera) :
 		cam(camera),
 		activeChunk(mapchunk(cam.camPos.x), mapchunk(cam.camPos.z)),
-		cache(activeChunk.x - Cache::dim() / 2, activeChunk.y - Cache::dim() / 2),
+		terrainBuffers(Cache::volume()),
+		cache(activeChunk.x - Cache::dim() / 2, activeChunk.y - Cache::dim() / 2, &terrainBuffers),
 		spit(),
-		chunkshader("shaders/chunkshader.vs", "shaders/chunkshader.fs"),
+		terrainTextures({ "textures/grass_top.png", "textures/sand.png", "textures/stone.png" }),	// using minecraft textures, all credit to mojang
+		chunkshader(Chunk::vertexShaderPath(), "shaders/chunkshader.fs"),
 		waterShader("shaders/basic.vs", "shaders/basicwatershader.fs"),
 		modelShader("shaders/basic.vs", "shaders/basic.fs"),
 		testShader("shaders/test.vs","shaders/test.fs"),
+		frameData(FRAME_DATA_BINDING),
 		origin(0.0f)
 		//objspawn(0,60,0),
 		//obj(objspawn)
 	{
-		// load and generate terrain textures
-		grasstex.load("textures/grass_top.png");
-		sandtex.load("textures/sand.png");
-		stonetex.load("textures/stone.png");
+		// upload terrain textures once decoded - decoding on the thread pool overlaps shader compilation
+		terrainTextures.upload();
+
+		// wait for the shader programs - they compile concurrently from construction until here
+		for (Shader* shader : { &chunkshader, &waterShader, &modelShader, &testShader }) shader->finish();
 
 		// setup chunkshader
 		chunkshader.use();
-		chunkshader.setInt("grasstex", 0);				// upload multiple textures to shader - https://stackoverflow.com/a/25252981
-		chunkshader.setInt("sandtex", 1);				// using minecraft textures, all credit to mojang
-		chunkshader.setInt("stonetex", 2);
-		sunPosition = glm::vec3(14, 60, 22);
-		glm::vec3 lightdir = glm::normalize(origin - sunPosition);
-		chunkshader.setVec3("dlight.direction", lightdir);
-		chunkshader.setVec3("dlight.ambient", 0.2f, 0.2f, 0.2f);
-		chunkshader.setVec3("dlight.diffuse", 0.5f, 0.5f, 0.5f);
-		chunkshader.setVec3("dlight.specular", 0.2f, 0.2f, 0.2f);
+		chunkshader.setInt("terrainTextures", 0);
+		Chunk::setupShader(chunkshader);
 
-		// bind multiple textures for rendering terrain
+		// setup lighting once for every shader - camera state is added to the shared frame data each update
+		sunPosition = glm::vec3(14, 60, 22);
+		frameData.data.lightDirection = glm::vec4(glm::normalize(origin - sunPosition), 0.0f);
+		frameData.data.lightAmbient = glm::vec4(0.2f, 0.2f, 0.2f, 0.0f);
+		frameData.data.lightDiffuse = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+		frameData.data.lightSpecular = glm::vec4(0.2f, 0.2f, 0.2f, 0.0f);
+		frameData.upload();
+		for (Shader* shader : { &chunkshader, &waterShader, &modelShader, &testShader }) shader->bindBlock("FrameData", FRAME_DATA_BINDING);
+
+		// bind the terrain texture array once - it stays bound to unit 0 for every frame
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, grasstex.id);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, sandtex.id);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, stonetex.id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, terrainTextures.id);
 
 		waterShader.use();
 		waterShader.setMat4("modelMatrix", glm::mat4(1.0));
-		waterShader.setVec3("dlight.direction", lightdir);
-		waterShader.setVec3("dlight.ambient", 0.2f, 0.2f, 0.2f);
-		waterShader.setVec3("dlight.diffuse", 0.5f, 0.5f, 0.5f);
-		waterShader.setVec3("dlight.specular", 0.2f, 0.2f, 0.2f);
-
-		modelShader.use();
-		modelShader.setVec3("dlight.direction", lightdir);
-		modelShader.setVec3("dlight.ambient", 0.2f, 0.2f, 0.2f);
-		modelShader.setVec3("dlight.diffuse", 0.5f, 0.5f, 0.5f);
-		modelShader.setVec3("dlight.specular", 0.2f, 0.2f, 0.2f);
 	}
 
 	// returns the height of the terrain at the given world coordinate
 	inline float testHeight(float x, float y) {
-		return cache.getHeight(mapchunk(x), mapchunk(y), x, y);
+		return cache.getHeight(x, y);
+	}
+
+	// returns the height of the terrain at count world coordinates - out[i] = testHeight(x[i], y[i])
+	inline void testHeights(const float* x, const float* y, float* out, int count) {
+		cache.getHeights(x, y, out, count);
+	}
+
+	// returns the number of generated terrain chunks still waiting to be uploaded to the GPU
+	inline int pendingUploads() {
+		return cache.pendingUploads();
+	}
+
+	// returns the total number of heap allocations made by terrain chunk loading - stops growing once flight reaches a steady state
+	// counted only when built with COUNT_HEAP_ALLOCATIONS, 0 otherwise
+	inline size_t chunkAllocations() {
+		return cache.allocations();
 	}
 
 	// update world - perform physics updates, draw world within render distance, etc...
 	// - deltatime = time difference between current and previous frames [useful for physics]
 	void update(double deltatime) {
+		PROFILE_ZONE("World::update");
+		gpuTimer.collect();
 
 		// compute active chunk coords
 		activeChunk.x = mapchunk(cam.camPos.x);
 		activeChunk.y = mapchunk(cam.camPos.z);
-		// setup chunk shader for drawing
+		// upload camera state shared by every shader, then setup chunk shader for drawing
+		glm::mat4 projectionView = cam.proj * cam.GetViewMatrix();
+		frameData.data.projectionViewMatrix = projectionView;
+		frameData.data.viewpos = glm::vec4(cam.camPos, 1.0f);
+		frameData.upload();
 		chunkshader.use();
-		chunkshader.setVec3("viewpos", cam.camPos);
-		chunkshader.setMat4("projectionViewMatrix", cam.proj * cam.GetViewMatrix());
-
-		//waterShader.use();
-		//waterShader.setVec3("viewpos", cam.camPos);
-		//waterShader.setMat4("projectionViewMatrix", cam.proj * cam.GetViewMatrix());
 		
 		// draw chunks within render distance in a spiral originating at the active chunk
-		// this ensures the central chunk will be loaded first (at least on startup)
+		// this ensures the central chunk will be loaded first (at least on startup). distant rings are drawn at coarser levels of detail
 		spit.reset();
+		cache.focus((int)activeChunk.x, (int)activeChunk.y, cam.camForward, projectionView);	// chunks outside of the view frustum are culled
 		cache.pollInitRequests();
 		for (int i = 0; i < RENDER_VOLUME; i++) {
-			cache.draw(spit.getx() + activeChunk.x, spit.getz() + activeChunk.y, chunkshader, waterShader);
+			cache.draw(spit.getx() + activeChunk.x, spit.getz() + activeChunk.y, lod(spit.ring()));
 			spit.next();
 		}
+		gpuTimer.begin("terrain");
+		cache.render();
+		gpuTimer.end();
 
 	}
 };
@@ -9,16 +9,22 @@ in vec2 texcoord;
 
 struct DLight {
 	vec3 direction;		// directional light direction vector. keep w component 0.0f if vec4
-	vec3 diffuse;
-	vec3 ambient;
-	vec3 specular;
+	vec3 diffuse;		// diffuse color
+	vec3 ambient;		// ambient color
+	vec3 specular;		// specular color
 };
 
-uniform vec3 viewpos;
-uniform sampler2D grasstex;
-uniform sampler2D sandtex;
-uniform sampler2D stonetex;
-uniform DLight dlight;	// directional light (ie. the sun)
+layout (std140) uniform FrameData {		// per frame state shared by every program - declared identically in every shader (World::FrameData)
+	mat4 projectionViewMatrix;
+	vec3 viewpos;
+	DLight dlight;						// directional light (ie. the sun)
+};
+
+uniform sampler2DArray terrainTextures;	// one layer per terrain texture, in the order World loads them
+
+const float GRASS = 0.0;				// terrain texture layers
+const float SAND = 1.0;
+const float STONE = 2.0;
 
 void main() {
 	// compute fragment normal 
@@ -34,8 +40,8 @@ void main() {
 	
 	// compute combined result
 	vec3 result = (ambient + diffuse);
-	if (fragpos.y < 0.3f) result = result * texture(sandtex, texcoord).rgb;			// sand
-	else if (fragpos.y < 15) result = result * vec3(0.0f, 0.8f, 0.1f) * texture(grasstex, texcoord).rgb;		// grass
-	else result = result * texture(stonetex, texcoord).rgb;					// mountain
+	if (fragpos.y < 0.3f) result = result * texture(terrainTextures, vec3(texcoord, SAND)).rgb;			// sand
+	else if (fragpos.y < 15) result = result * vec3(0.0f, 0.8f, 0.1f) * texture(terrainTextures, vec3(texcoord, GRASS)).rgb;		// grass
+	else result = result * texture(terrainTextures, vec3(texcoord, STONE)).rgb;					// mountain
 	fragcolor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#version 330 core
+
+layout (location = 0) in float height;		// height normalized over the terrain height limits
+layout (location = 1) in vec2 octnorm;		// octahedral encoded normal
+
+out vec3 fragpos;
+out vec3 normal;
+out vec2 texcoord;
+
+struct DLight {
+	vec3 direction;		// directional light direction vector. keep w component 0.0f if vec4
+	vec3 diffuse;		// diffuse color
+	vec3 ambient;		// ambient color
+	vec3 specular;		// specular color
+};
+
+layout (std140) uniform FrameData {		// per frame state shared by every program - declared identically in every shader (World::FrameData)
+	mat4 projectionViewMatrix;
+	vec3 viewpos;
+	DLight dlight;						// directional light (ie. the sun)
+};
+
+uniform samplerBuffer chunkOrigins;			// world space XZ origin of the chunk in each vertex buffer slot
+uniform int vdim;							// # vertices along one side of a chunk
+uniform float cellScale;					// width of one cell in world space
+uniform float texIncrement;					// texture coordinate increment per cell
+uniform float heightMin;					// terrain height limits
+uniform float heightRange;
+
+vec3 decodeNormal(vec2 e) {
+	vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+	if (n.y < 0.0) n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+void main() {
+	// gl_VertexID includes the base vertex of the chunk's slot - recover the slot and the grid coordinate within it
+	int slot = gl_VertexID / (vdim * vdim);
+	int local = gl_VertexID - slot * vdim * vdim;
+	vec2 grid = vec2(local % vdim, local / vdim);
+	vec2 origin = texelFetch(chunkOrigins, slot).xy;
+
+	vec3 pos = vec3(origin.x + grid.x * cellScale, heightMin + height * heightRange, origin.y + grid.y * cellScale);
+	fragpos = pos;
+	normal = decodeNormal(octnorm);
+	texcoord = grid * texIncrement;
+	gl_Position = projectionViewMatrix * vec4(pos, 1.0);
+}
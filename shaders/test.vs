@@ -7,7 +7,19 @@ layout(location = 1) in vec3 norm;
 out vec3 fragpos;
 out vec3 normal;
 
-uniform mat4 projectionViewMatrix;
+struct DLight {
+	vec3 direction;		// directional light direction vector. keep w component 0.0f if vec4
+	vec3 diffuse;		// diffuse color
+	vec3 ambient;		// ambient color
+	vec3 specular;		// specular color
+};
+
+layout (std140) uniform FrameData {		// per frame state shared by every program - declared identically in every shader (World::FrameData)
+	mat4 projectionViewMatrix;
+	vec3 viewpos;
+	DLight dlight;						// directional light (ie. the sun)
+};
+
 uniform mat4 modelMatrix;
 
 void main() {